@@ -0,0 +1,193 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ring_buffer.h"
+
+/*
+ * Streams frames from a producer to a consumer thread and reports the
+ * throughput of RingBuffer (copying and region APIs) next to the modulo
+ * ring buffer main.c used before, across a few block sizes.
+ */
+
+#define BENCH_FRAMES 50000000
+#define BENCH_CAPACITY 1024
+
+typedef enum {
+    BENCH_LEGACY,
+    BENCH_COPY,
+    BENCH_REGION,
+} BenchMode;
+
+typedef struct {
+    float *buffer;
+    int size;
+    atomic_int readPos;
+    atomic_int writePos;
+} LegacyRingBuffer;
+
+typedef struct {
+    BenchMode mode;
+    RingBuffer *rb;
+    LegacyRingBuffer *legacy;
+    int blockSize;
+    int channels;
+    double checksum;
+} BenchThread;
+
+/* LEGACY RING BUFFER, as in main.c before the library ring buffer */
+
+static bool legacy_write(LegacyRingBuffer *rb, const float *data, int numSamples) {
+    int readPos = atomic_load_explicit(&rb->readPos, memory_order_acquire);
+    int writePos = atomic_load_explicit(&rb->writePos, memory_order_relaxed);
+    int available = (readPos > writePos) ? (readPos - writePos) : (rb->size - writePos + readPos);
+    if (available < numSamples) return false;
+
+    int spaceToEnd = rb->size - writePos;
+    if (spaceToEnd >= numSamples) {
+        memcpy(&rb->buffer[writePos], data, numSamples * sizeof(float));
+    } else {
+        memcpy(&rb->buffer[writePos], data, spaceToEnd * sizeof(float));
+        memcpy(&rb->buffer[0], &data[spaceToEnd], (numSamples - spaceToEnd) * sizeof(float));
+    }
+    atomic_store_explicit(&rb->writePos, (writePos + numSamples) % rb->size, memory_order_release);
+    return true;
+}
+
+static bool legacy_read(LegacyRingBuffer *rb, float *data, int numSamples) {
+    int readPos = atomic_load_explicit(&rb->readPos, memory_order_relaxed);
+    int writePos = atomic_load_explicit(&rb->writePos, memory_order_acquire);
+    int available = (writePos >= readPos) ? (writePos - readPos) : (rb->size - readPos + writePos);
+    if (available < numSamples) return false;
+
+    int spaceToEnd = rb->size - readPos;
+    if (spaceToEnd >= numSamples) {
+        memcpy(data, &rb->buffer[readPos], numSamples * sizeof(float));
+    } else {
+        memcpy(data, &rb->buffer[readPos], spaceToEnd * sizeof(float));
+        memcpy(&data[spaceToEnd], &rb->buffer[0], (numSamples - spaceToEnd) * sizeof(float));
+    }
+    atomic_store_explicit(&rb->readPos, (readPos + numSamples) % rb->size, memory_order_release);
+    return true;
+}
+
+/* BENCHMARK */
+
+static void* producer(void *args) {
+    BenchThread *bench = (BenchThread*)args;
+    const int samples = bench->blockSize * bench->channels;
+    float *block = (float*)malloc(samples * sizeof(float));
+    for (int i = 0; i < samples; i++) {block[i] = (float)i;}
+
+    for (long sent = 0; sent < BENCH_FRAMES; sent += bench->blockSize) {
+        switch (bench->mode) {
+            case BENCH_LEGACY:
+                while (!legacy_write(bench->legacy, block, samples)) {sched_yield();}
+                break;
+            case BENCH_COPY:
+                while (!ring_buffer_write(bench->rb, block, bench->blockSize)) {sched_yield();}
+                break;
+            case BENCH_REGION: {
+                RingBufferRegion region;
+                while (ring_buffer_acquire_write(bench->rb, bench->blockSize, &region) < bench->blockSize) {sched_yield();}
+                memcpy(region.data[0], block, region.frames[0] * bench->channels * sizeof(float));
+                memcpy(region.data[1], block + region.frames[0] * bench->channels,
+                       region.frames[1] * bench->channels * sizeof(float));
+                ring_buffer_commit_write(bench->rb, bench->blockSize);
+                break;
+            }
+        }
+    }
+    free(block);
+    return NULL;
+}
+
+static void* consumer(void *args) {
+    BenchThread *bench = (BenchThread*)args;
+    const int samples = bench->blockSize * bench->channels;
+    float *block = (float*)malloc(samples * sizeof(float));
+    double checksum = 0.0;
+
+    for (long received = 0; received < BENCH_FRAMES; received += bench->blockSize) {
+        switch (bench->mode) {
+            case BENCH_LEGACY:
+                while (!legacy_read(bench->legacy, block, samples)) {sched_yield();}
+                checksum += block[samples - 1];
+                break;
+            case BENCH_COPY:
+                while (!ring_buffer_read(bench->rb, block, bench->blockSize)) {sched_yield();}
+                checksum += block[samples - 1];
+                break;
+            case BENCH_REGION: {
+                // consume in place, no copy out of the ring
+                RingBufferRegion region;
+                while (ring_buffer_acquire_read(bench->rb, bench->blockSize, &region) < bench->blockSize) {sched_yield();}
+                const int last = region.frames[1] > 0 ? 1 : 0;
+                checksum += region.data[last][region.frames[last] * bench->channels - 1];
+                ring_buffer_commit_read(bench->rb, bench->blockSize);
+                break;
+            }
+        }
+    }
+    bench->checksum = checksum;
+    free(block);
+    return NULL;
+}
+
+static double run(BenchMode mode, int blockSize, int channels) {
+    BenchThread bench = {mode, NULL, NULL, blockSize, channels, 0.0};
+    LegacyRingBuffer legacy;
+
+    if (mode == BENCH_LEGACY) {
+        legacy.size = BENCH_CAPACITY * channels + 1;
+        legacy.buffer = (float*)malloc(legacy.size * sizeof(float));
+        atomic_init(&legacy.readPos, 0);
+        atomic_init(&legacy.writePos, 0);
+        bench.legacy = &legacy;
+    } else {
+        bench.rb = create_ring_buffer(BENCH_CAPACITY, channels);
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pthread_t producerThread, consumerThread;
+    pthread_create(&producerThread, NULL, producer, &bench);
+    pthread_create(&consumerThread, NULL, consumer, &bench);
+    pthread_join(producerThread, NULL);
+    pthread_join(consumerThread, NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (mode == BENCH_LEGACY) {
+        free(legacy.buffer);
+    } else {
+        destroy_ring_buffer(bench.rb);
+    }
+
+    const double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+    return BENCH_FRAMES / seconds / 1e6;
+}
+
+int main(void) {
+    const int blockSizes[] = {16, 64, 128, 512};
+    const int channelCounts[] = {1, 2};
+
+    printf("%-8s %-6s %12s %12s %12s   (Mframes/s)\n", "channels", "block", "legacy", "copy", "region");
+    for (int c = 0; c < 2; c++) {
+        for (int b = 0; b < 4; b++) {
+            const int channels = channelCounts[c];
+            const int blockSize = blockSizes[b];
+            printf("%-8d %-6d %12.1f %12.1f %12.1f\n", channels, blockSize,
+                   run(BENCH_LEGACY, blockSize, channels),
+                   run(BENCH_COPY, blockSize, channels),
+                   run(BENCH_REGION, blockSize, channels));
+            fflush(stdout);
+        }
+    }
+    return 0;
+}
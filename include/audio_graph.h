@@ -1,11 +1,18 @@
 #ifndef keiko_audio_graph_h
 #define keiko_audio_graph_h
 
+#include <stdbool.h>
 #include "audio_module.h"
+#include "sample_format.h"
+
+// samples per control period unless the graph sets its own; init_graph
+// runs at the nearest divisor of the sample rate below it, e.g. 30 at 44100 Hz
+#define AUDIO_GRAPH_CONTROL_PERIOD 32
 
 typedef struct Connection Connection;
 typedef struct AudioNode AudioNode;
 typedef struct AudioGraph AudioGraph;
+typedef struct ProcessingStep ProcessingStep;
 
 struct AudioNode {
     void* instance;
@@ -16,26 +23,81 @@ struct AudioNode {
     Connection **outgoing;
     int numIncoming;
     int numOutgoing;
+    // incoming connections that drive a parameter rather than the input mix
+    int numParameterInputs;
+
+    // copied from the module, may be changed before init_graph
+    ModuleRate rate;
+    // control and event nodes ramp from one computed value to the next
+    // over a control period; the output buffer holds the ramp at audio rate.
+    // The first value after init is taken as is rather than ramped up to
+    float rampFrom;
+    float rampTo;
+    int rampPos;
+    bool rampStarted;
+    int settledSamples;
+    bool dirty;
+
+    // set by init_graph: an audio node whose outgoing connections all
+    // accept the same compact format renders into the graph's scratch
+    // buffer and keeps its output only in compactOutput
+    SampleFormat outputFormat;
+    void *compactOutput;
 };
 
 struct Connection {
     AudioNode *source;
     AudioNode *destination;
+    // storage the destination tolerates for this signal, float by default
+    SampleFormat format;
+    // parameter set from the source at every control tick, or -1 to mix into the input
+    int parameterId;
+    float lastValue;
+};
+
+// one node, or a fused chain where each node feeds only the next
+struct ProcessingStep {
+    AudioNode **nodes;
+    int numNodes;
 };
 
 struct AudioGraph {
     AudioNode **nodes;
+    AudioNode **processingOrder;
+    ProcessingStep *steps;
     Connection **connections;
     int numNodes;
+    int numSteps;
     int numConnections;
+    bool fuseChains;
+
+    // requested samples per control tick; init_graph lowers it to a divisor
+    // of the sample rate in effectiveControlPeriod, so control rates are exact.
+    // Ticks are counted by controlPhase
+    int controlPeriod;
+    int effectiveControlPeriod;
+    int controlPhase;
+    float *controlInput;
+    float *controlOutput;
+    // float output of whichever compact node is running
+    float *scratch;
 };
 
 AudioGraph* create_audio_graph(void); 
 void destroy_audio_graph(AudioGraph *graph);
 AudioNode* create_audio_node(AudioModuleInterface *interface);
 void add_node(AudioGraph *graph, AudioNode *node);
-void connect_nodes(AudioGraph *graph, AudioNode *src, AudioNode *dest);
+Connection* connect_nodes(AudioGraph *graph, AudioNode *src, AudioNode *dest);
+/*
+ * Drives one of dest's parameters from src instead of mixing src into its
+ * input. The source is sampled at every control tick and the value handed
+ * to setParameter when it changes; an audio node is processed in pieces
+ * split at the ticks, and an event node runs again after a change.
+ */
+Connection* connect_parameter(AudioGraph *graph, AudioNode *src, AudioNode *dest, int parameterId);
 void init_graph(AudioGraph *graph, int sampleRate, int bufferSize);
 void process_graph(AudioGraph *graph, int numSamples);
+// sets a parameter and schedules an event rate node to run again
+void set_node_parameter(AudioNode *node, int parameterId, float value);
 
 #endif 
@@ -1,6 +1,16 @@
 #ifndef keiko_audio_module_h
 #define keiko_audio_module_h
 
+// how often the graph runs a module, see process_graph
+typedef enum {
+    // every sample
+    MODULE_RATE_AUDIO,
+    // once per control period, at sampleRate / controlPeriod
+    MODULE_RATE_CONTROL,
+    // once after each parameter change made through set_node_parameter
+    MODULE_RATE_EVENT,
+} ModuleRate;
+
 typedef struct {
     void* (*create)(void);
     void  (*destroy)(void* instance);
@@ -9,6 +19,12 @@ typedef struct {
     void  (*setParameter)(void *instance, int parameterId, float value);
     float  (*getParameter)(void *instance, int parameterId);
     void  (*reset)(void *instance);
+    // optional, processing delay in samples introduced by the module
+    int   (*getLatency)(void *instance);
+    // optional, process() in place on any sub-block chunk; lets the graph fuse chains
+    void  (*processInPlace)(void *instance, float *buffer, int numSamples);
+    // default rate class for nodes of this module, audio unless set
+    ModuleRate rate;
 } AudioModuleInterface;
 
 #endif
@@ -0,0 +1,23 @@
+#ifndef keiko_cpu_features_h
+#define keiko_cpu_features_h
+
+#include <stdbool.h>
+
+/*
+ * On x86 with GCC or Clang, kernels for newer instruction sets are built
+ * with a target attribute next to the baseline code and chosen at run
+ * time, so a default build still uses them where the CPU has them.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CPU_FEATURES_DISPATCH 1
+#endif
+
+// byte shuffles (pshufb)
+bool cpu_has_ssse3(void);
+bool cpu_has_avx(void);
+// FMA3 together with AVX
+bool cpu_has_fma(void);
+// half precision conversions together with AVX
+bool cpu_has_f16c(void);
+
+#endif
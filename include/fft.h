@@ -0,0 +1,35 @@
+#ifndef keiko_fft_h
+#define keiko_fft_h
+
+/*
+ * Real-input FFT of power-of-two size N. Spectra are stored split-complex:
+ * separate real and imaginary arrays of N/2+1 bins each, which keeps the
+ * spectral multiply-add in convolution friendly to SIMD.
+ */
+typedef struct {
+    int size;
+    int half;
+    int *bitReverse;
+    float *twiddleRe;
+    float *twiddleIm;
+    float *splitRe;
+    float *splitIm;
+    float *workRe;
+    float *workIm;
+} RealFFT;
+
+RealFFT* create_real_fft(int size);
+void destroy_real_fft(RealFFT *fft);
+
+// input: size samples -> re/im: size/2+1 bins, unscaled
+void real_fft_forward(RealFFT *fft, const float *input, float *re, float *im);
+// re/im: size/2+1 bins -> output: size samples, scaled by 1/size
+void real_fft_inverse(RealFFT *fft, const float *re, const float *im, float *output);
+
+// acc += a * b over numBins split-complex bins
+void complex_multiply_accumulate(float *accRe, float *accIm,
+                                 const float *aRe, const float *aIm,
+                                 const float *bRe, const float *bIm,
+                                 int numBins);
+
+#endif
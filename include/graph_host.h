@@ -0,0 +1,65 @@
+#ifndef keiko_graph_host_h
+#define keiko_graph_host_h
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "audio_graph.h"
+
+// receives every rendered block of a session; runs on a host worker thread.
+// Returns false to refuse the block when it has no room, and is offered the
+// same block again later
+typedef bool (*GraphSink)(void *userData, const float *samples, int numSamples);
+
+typedef struct GraphSession GraphSession;
+typedef struct GraphHost GraphHost;
+
+struct GraphSession {
+    AudioGraph *graph;
+    AudioNode *output;
+    GraphSink sink;
+    void *sinkData;
+
+    int blockSize;
+    int64_t periodNs;
+    int64_t leadNs;
+    // the next block must be delivered by deadlineNs and may start at deadlineNs - leadNs
+    int64_t deadlineNs;
+
+    bool busy;
+    // the last block was refused by the sink and has not been delivered yet
+    bool pending;
+
+    uint64_t blocksRendered;
+    uint64_t deadlineMisses;
+    uint64_t sinkStalls;
+};
+
+struct GraphHost {
+    pthread_t *workers;
+    int numWorkers;
+
+    GraphSession **sessions;
+    int numSessions;
+
+    pthread_mutex_t lock;
+    // wakes workers when sessions change
+    pthread_cond_t cond;
+    // broadcast when a block finishes, for remove_graph_session
+    pthread_cond_t idle;
+    bool running;
+};
+
+GraphHost* create_graph_host(int numWorkers);
+// stops the workers and frees any sessions still attached; their graphs stay owned by the caller
+void destroy_graph_host(GraphHost *host);
+
+// graph must already be initialised with blockSize; output is its OutputNode.
+// latencyBlocks is how far ahead of real time the session may render
+GraphSession* add_graph_session(GraphHost *host, AudioGraph *graph, AudioNode *output,
+                                int sampleRate, int blockSize, int latencyBlocks,
+                                GraphSink sink, void *sinkData);
+// waits for an in-flight block to finish, then frees the session
+void remove_graph_session(GraphHost *host, GraphSession *session);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef keiko_mapped_sample_h
+#define keiko_mapped_sample_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "wav_file.h"
+
+// a wav file mapped read-only into memory; pages are only loaded when touched
+typedef struct {
+    int fd;
+    unsigned char *map;
+    size_t mapSize;
+    size_t pageSize;
+    WavInfo info;
+    const float *direct;
+} MappedSample;
+
+MappedSample* open_mapped_sample(const char *path);
+void close_mapped_sample(MappedSample *sample);
+
+// asks the kernel to read ahead and faults the range in; may block on disk
+void mapped_sample_prefetch(MappedSample *sample, int frame, int numFrames);
+// drops the range from this process' page tables, the page cache keeps it
+void mapped_sample_release(MappedSample *sample, int frame, int numFrames);
+
+// mixes numFrames frames starting at frame down to mono float
+void mapped_sample_read(const MappedSample *sample, int frame, int numFrames, float *output);
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef keiko_convolution_reverb_module_h
+#define keiko_convolution_reverb_module_h
+
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include "audio_module.h"
+#include "fft.h"
+
+extern AudioModuleInterface ConvolutionReverbModule;
+
+enum {
+    CONV_WET_PARAM,
+    CONV_DRY_PARAM,
+};
+
+// tail partitions are this many head partitions long
+#define CONV_TAIL_RATIO 16
+
+// uniformly partitioned overlap-save convolver, one block of blockSize per call
+typedef struct {
+    RealFFT *fft;
+    int blockSize;
+    int numBins;
+    int numPartitions;
+    int fdlPos;
+    float *irRe, *irIm;
+    float *fdlRe, *fdlIm;
+    float *accRe, *accIm;
+    float *timeBuffer;
+    float *outputBuffer;
+} PartitionedConvolver;
+
+typedef struct {
+    //impulse response
+    float *ir;
+    int irLength;
+    int irSampleRate;
+
+    //parameters
+    float wet, dry;
+    int sampleRate;
+
+    //head stage, runs in the audio thread
+    PartitionedConvolver *head;
+    int blockSize;
+    float *inputFifo;
+    float *outputFifo;
+    float *headOutput;
+    int fifoPos;
+
+    //tail stage, runs in the worker thread
+    PartitionedConvolver *tail;
+    int tailBlockSize;
+    float *tailInput;
+    float *tailOutput;
+    float *jobInput;
+    float *jobOutput;
+    int tailPos;
+
+    pthread_t worker;
+    sem_t jobReady;
+    bool workerRunning;
+    atomic_bool quit;
+    // tail jobs are numbered; the audio thread posts one only when the
+    // worker has completed the last, so neither side waits on the other
+    atomic_uint jobsPosted;
+    atomic_uint jobsDone;
+    // the late result still in jobOutput belongs to a period already played
+    bool dropLateResult;
+    // tail blocks lost because the worker had not finished in time
+    atomic_int overruns;
+
+    // run tail jobs inline, for renders that are not paced in real time
+    bool offline;
+} ConvolutionReverb;
+
+// not realtime safe; rebuilds the partitions if the module is already initialised
+bool convolution_reverb_load_ir(ConvolutionReverb *reverb, const char *path);
+bool convolution_reverb_set_ir(ConvolutionReverb *reverb, const float *ir, int length, int sampleRate);
+// offline rendering gives the same output as a worker that is never late
+void convolution_reverb_set_offline(ConvolutionReverb *reverb, bool offline);
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef keiko_sampler_module_h
+#define keiko_sampler_module_h
+
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "audio_module.h"
+#include "mapped_sample.h"
+#include "resampler.h"
+
+extern AudioModuleInterface SamplerModule;
+
+enum {
+    SAMPLER_GAIN_PARAM,
+    SAMPLER_LOOP_PARAM,
+    SAMPLER_TRIGGER_PARAM,
+};
+
+// frames kept resident from load so a trigger never waits on the disk
+#define SAMPLER_PRELOAD_FRAMES 32768
+// frames the streaming thread keeps resident ahead of the playhead
+#define SAMPLER_STREAM_AHEAD_FRAMES 65536
+
+typedef struct {
+    MappedSample *sample;
+    int preloadFrames;
+
+    //parameters
+    float gain;
+    bool loop;
+    int sampleRate;
+    int bufferSize;
+
+    //set up by init when the file rate differs from the engine rate
+    Resampler *resampler;
+    float *resampleInput;
+
+    //playback, owned by the audio thread
+    int position;
+    bool playing;
+    atomic_bool triggerPending;
+
+    //shared with the streaming thread
+    atomic_int playhead;
+    atomic_uint generation;
+    atomic_uint_least64_t ready;
+    atomic_int underruns;
+    // set while the voice plays; the streamer sleeps when no sampler is
+    atomic_bool streaming;
+
+    //owned by the streaming thread once registered with it
+    bool registered;
+    unsigned streamGeneration;
+    int residentUntil;
+    int releasedUntil;
+} Sampler;
+
+// not realtime safe; maps the file and registers it with the shared streaming thread
+bool sampler_load(Sampler *sampler, const char *path);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef keiko_subgraph_module_h
+#define keiko_subgraph_module_h
+
+#include "audio_module.h"
+#include "audio_graph.h"
+#include "resampler.h"
+
+extern AudioModuleInterface SubgraphModule;
+
+/*
+ * Runs an inner graph at its own, usually lower, sample rate. The node's
+ * input is resampled down and appears as the output of the inner `input`
+ * node; the inner OutputNode passed to subgraph_set_output is resampled
+ * back up to become this node's output. Inner nodes are added to `graph`
+ * and are owned by it.
+ */
+typedef struct {
+    AudioGraph *graph;
+    AudioNode *input;
+    AudioNode *output;
+
+    int internalRate;
+    int sampleRate;
+    int internalBufferSize;
+
+    Resampler *down;
+    Resampler *up;
+    // input at the inner rate, waiting for the inner graph
+    float *inputFifo;
+    int fifoFill;
+} Subgraph;
+
+// 0 runs the inner graph at the outer rate; takes effect at the next init
+void subgraph_set_sample_rate(Subgraph *subgraph, int sampleRate);
+void subgraph_set_output(Subgraph *subgraph, AudioNode *output);
+
+#endif
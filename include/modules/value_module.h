@@ -0,0 +1,17 @@
+#ifndef keiko_value_module_h
+#define keiko_value_module_h
+
+#include "audio_module.h"
+
+// a constant set by parameter; runs at event rate, so the graph ramps between values
+extern AudioModuleInterface ValueModule;
+
+enum {
+    VALUE_PARAM,
+};
+
+typedef struct {
+    float value;
+} Value;
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef keiko_resampler_h
+#define keiko_resampler_h
+
+#include <stdbool.h>
+
+// taps per phase when not decimating, before rounding to the SIMD width
+#define RESAMPLER_TAPS 64
+// rational ratios whose reduced output rate exceeds this interpolate between phases
+#define RESAMPLER_MAX_PHASES 512
+
+/*
+ * Streaming polyphase resampler with a Kaiser windowed sinc, for any ratio
+ * of two integer rates. The ratio is reduced by the gcd, and if the reduced
+ * output rate fits in RESAMPLER_MAX_PHASES every output position falls
+ * exactly on one of the filter bank phases. Otherwise the two nearest
+ * phases are interpolated. When decimating, the cutoff is scaled down and
+ * the filter gets longer, so the number of taps per input sample stays
+ * roughly constant.
+ *
+ * The filter is causal: output j is available once input
+ * floor(j * inputRate / outputRate) has been pushed, and it lags the input
+ * by resampler_latency() output samples.
+ */
+typedef struct {
+    int inputRate;
+    int outputRate;
+    int numTaps;
+    int numPhases;
+    bool interpolate;
+    float phaseScale;
+    float *filters;
+
+    // input history; the next output is centred numTaps/2 before buffer[index] + frac/outputRate
+    float *buffer;
+    int bufferSize;
+    int fill;
+    int index;
+    int frac;
+} Resampler;
+
+Resampler* create_resampler(int inputRate, int outputRate);
+void destroy_resampler(Resampler *resampler);
+void reset_resampler(Resampler *resampler);
+
+// outputs one call with numInput samples can produce
+int resampler_max_output(const Resampler *resampler, int numInput);
+// inputs needed for the next call to produce numOutput samples
+int resampler_input_needed(const Resampler *resampler, int numOutput);
+// delay of the output relative to the input, in output samples
+int resampler_latency(const Resampler *resampler);
+
+/*
+ * Writes at most maxOutput samples and returns how many were written.
+ * Every input is taken as long as maxOutput is at least
+ * resampler_max_output(numInput) (push) or numInput is at most
+ * resampler_input_needed(maxOutput) (pull, which then yields exactly
+ * maxOutput samples).
+ */
+int resampler_process(Resampler *resampler, const float *input, int numInput, float *output, int maxOutput);
+
+// not realtime safe; converts a whole buffer with the latency removed, caller frees
+float* resample_buffer(const float *input, int length, int inputRate, int outputRate, int *outputLength);
+
+#endif
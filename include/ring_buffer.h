@@ -0,0 +1,55 @@
+#ifndef keiko_ring_buffer_h
+#define keiko_ring_buffer_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#define RING_BUFFER_CACHE_LINE 64
+
+/*
+ * Single-producer single-consumer ring of interleaved float frames.
+ * Positions are free-running frame counters masked into a power-of-two
+ * capacity, so every slot is usable and no division is needed. Producer
+ * and consumer state live on separate cache lines, and each side keeps a
+ * cached copy of the other side's position so it only touches the shared
+ * line when the cached value says the buffer looks full (or empty).
+ */
+typedef struct {
+    float *buffer;
+    size_t capacity;
+    size_t mask;
+    int channels;
+
+    //producer side
+    _Alignas(RING_BUFFER_CACHE_LINE) atomic_size_t writePos;
+    size_t cachedReadPos;
+
+    //consumer side
+    _Alignas(RING_BUFFER_CACHE_LINE) atomic_size_t readPos;
+    size_t cachedWritePos;
+} RingBuffer;
+
+// up to two contiguous spans of frames; the second is used when the region wraps
+typedef struct {
+    float *data[2];
+    int frames[2];
+} RingBufferRegion;
+
+// capacity is rounded up to a power of two frames
+RingBuffer* create_ring_buffer(int minFrames, int channels);
+void destroy_ring_buffer(RingBuffer *rb);
+
+// producer side
+int ring_buffer_write_available(RingBuffer *rb);
+bool ring_buffer_write(RingBuffer *rb, const float *frames, int numFrames);
+int ring_buffer_acquire_write(RingBuffer *rb, int numFrames, RingBufferRegion *region);
+void ring_buffer_commit_write(RingBuffer *rb, int numFrames);
+
+// consumer side
+int ring_buffer_read_available(RingBuffer *rb);
+bool ring_buffer_read(RingBuffer *rb, float *frames, int numFrames);
+int ring_buffer_acquire_read(RingBuffer *rb, int numFrames, RingBufferRegion *region);
+void ring_buffer_commit_read(RingBuffer *rb, int numFrames);
+
+#endif
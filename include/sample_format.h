@@ -0,0 +1,38 @@
+#ifndef keiko_sample_format_h
+#define keiko_sample_format_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// int16 storage covers [-SAMPLE_INT16_RANGE, SAMPLE_INT16_RANGE), leaving headroom above full scale
+#define SAMPLE_INT16_RANGE 2.0f
+
+/*
+ * How a node's output is kept between its step and its consumers'.
+ * Modules always process float; compact formats trade precision for half
+ * the memory traffic. INT16 is uniform with a step of
+ * SAMPLE_INT16_RANGE / 32768 and saturates outside its range; HALF is
+ * IEEE binary16 with 11 significant bits and a range of +-65504.
+ */
+typedef enum {
+    SAMPLE_FORMAT_FLOAT,
+    SAMPLE_FORMAT_INT16,
+    SAMPLE_FORMAT_HALF,
+} SampleFormat;
+
+// bytes per stored sample
+int sample_format_size(SampleFormat format);
+// whether conversions to and from format run vector code on this CPU
+bool sample_format_vectorized(SampleFormat format);
+
+void float_to_int16(const float *input, int16_t *output, int numSamples);
+// adds the stored samples times gain to output
+void int16_accumulate(const int16_t *input, float *output, float gain, int numSamples);
+float int16_sample(int16_t value);
+
+void float_to_half(const float *input, uint16_t *output, int numSamples);
+// adds the stored samples times gain to output
+void half_accumulate(const uint16_t *input, float *output, float gain, int numSamples);
+float half_sample(uint16_t value);
+
+#endif
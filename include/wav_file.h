@@ -0,0 +1,36 @@
+#ifndef keiko_wav_file_h
+#define keiko_wav_file_h
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef enum {
+    WAV_FORMAT_PCM16,
+    WAV_FORMAT_PCM24,
+    WAV_FORMAT_PCM32,
+    WAV_FORMAT_FLOAT32,
+} WavSampleFormat;
+
+typedef struct {
+    WavSampleFormat format;
+    int sampleRate;
+    int numChannels;
+    int numFrames;
+    int bytesPerFrame;
+    size_t dataOffset;
+} WavInfo;
+
+// parses a RIFF/WAVE header held in memory; data must cover at least the header chunks
+bool parse_wav_header(const unsigned char *data, size_t size, WavInfo *info);
+
+// converts numFrames frames of one channel from interleaved file data to float
+void convert_wav_channel(const WavInfo *info, const unsigned char *frames,
+                         int channel, float *output, int numFrames);
+
+// converts numFrames interleaved frames to float and averages the channels
+void convert_wav_mono(const WavInfo *info, const unsigned char *frames, float *output, int numFrames);
+
+// reads a whole file and mixes it down to mono; caller frees the result
+float* load_wav_mono(const char *path, int *numFrames, int *sampleRate);
+
+#endif
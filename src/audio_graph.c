@@ -1,3 +1,4 @@
+#include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -5,9 +6,20 @@
 #include "audio_graph.h"
 #include "audio_module.h"
 
+// samples per pass through a fused chain; keeps the working buffer in L1
+#define FUSION_CHUNK_SIZE 64
+
 static void free_node(AudioNode *node);
 static void free_connection(Connection *conn);
 static AudioNode** topological_sort(AudioGraph *graph);
+static void free_steps(AudioGraph *graph);
+static bool build_steps(AudioGraph *graph, AudioNode **order);
+static void mix_inputs(AudioNode *node, float *buffer, int numSamples);
+static float sample_output(const AudioNode *node, int index);
+static bool apply_parameters(AudioNode *node, int index, bool onlyNew);
+static void run_node(AudioGraph *graph, AudioNode *node, int numSamples);
+static SampleFormat output_format(AudioNode *node);
+static void store_output(AudioNode *node, int numSamples);
 
 AudioGraph* create_audio_graph(void) {
     AudioGraph *graph = (AudioGraph*)malloc(sizeof(AudioGraph));
@@ -16,9 +28,19 @@ AudioGraph* create_audio_graph(void) {
         return NULL;
     }
     graph->nodes = NULL;
+    graph->processingOrder = NULL;
+    graph->steps = NULL;
     graph->connections = NULL;
     graph->numNodes = 0;
+    graph->numSteps = 0;
     graph->numConnections = 0;
+    graph->fuseChains = true;
+    graph->controlPeriod = AUDIO_GRAPH_CONTROL_PERIOD;
+    graph->effectiveControlPeriod = AUDIO_GRAPH_CONTROL_PERIOD;
+    graph->controlPhase = 0;
+    graph->controlInput = NULL;
+    graph->controlOutput = NULL;
+    graph->scratch = NULL;
     return graph;
 }
 
@@ -29,6 +51,11 @@ void destroy_audio_graph(AudioGraph *graph) {
         free_node(graph->nodes[i]);
     }
     free(graph->nodes);
+    free(graph->processingOrder);
+    free_steps(graph);
+    free(graph->controlInput);
+    free(graph->controlOutput);
+    free(graph->scratch);
 
     for (int i = 0; i < graph->numConnections; i++) {
         free_connection(graph->connections[i]);
@@ -57,6 +84,16 @@ AudioNode* create_audio_node(AudioModuleInterface *interface){
     node->outgoing = NULL;
     node->numIncoming = 0;
     node->numOutgoing = 0;
+    node->numParameterInputs = 0;
+    node->rate = interface->rate;
+    node->rampFrom = 0.0f;
+    node->rampTo = 0.0f;
+    node->rampPos = 0;
+    node->rampStarted = false;
+    node->settledSamples = 0;
+    node->dirty = true;
+    node->outputFormat = SAMPLE_FORMAT_FLOAT;
+    node->compactOutput = NULL;
     return node;
 }
 
@@ -71,22 +108,25 @@ void add_node(AudioGraph *graph, AudioNode *node) {
     graph->nodes[graph->numNodes++] = node;
 }
 
-void connect_nodes(AudioGraph *graph, AudioNode *src, AudioNode *dest) {
-    if (!graph || !src || !dest) {return;}
+Connection* connect_nodes(AudioGraph *graph, AudioNode *src, AudioNode *dest) {
+    if (!graph || !src || !dest) {return NULL;}
 
     Connection* conn = (Connection*)malloc(sizeof(Connection));
     if (!conn) {
         fprintf(stderr, "Failed to create a connection\n");
-        return;
+        return NULL;
     }
     conn->source = src;
     conn->destination = dest;
+    conn->format = SAMPLE_FORMAT_FLOAT;
+    conn->parameterId = -1;
+    conn->lastValue = NAN;
 
     graph->connections = realloc(graph->connections, (graph->numConnections+1)*sizeof(Connection));
     if (!graph->connections) {
         fprintf(stderr, "failed to expand connection array");
         free(conn);
-        return;
+        return NULL;
     }
     graph->connections[graph->numConnections++] = conn;
 
@@ -94,7 +134,7 @@ void connect_nodes(AudioGraph *graph, AudioNode *src, AudioNode *dest) {
         (src->numOutgoing + 1) * sizeof(Connection*));
     if (!src->outgoing) {
         free(conn);
-        return;
+        return NULL;
     }
     src->outgoing[src->numOutgoing++] = conn;
 
@@ -102,68 +142,433 @@ void connect_nodes(AudioGraph *graph, AudioNode *src, AudioNode *dest) {
         (dest->numIncoming + 1) * sizeof(Connection*));
     if (!dest->incoming) {
         free(conn);
-        return;
+        return NULL;
     }
     dest->incoming[dest->numIncoming++] = conn;
+    return conn;
+}
+
+Connection* connect_parameter(AudioGraph *graph, AudioNode *src, AudioNode *dest, int parameterId) {
+    if (!graph || !src || !dest || parameterId < 0) {return NULL;}
+    if (!dest->interface->setParameter) {
+        fprintf(stderr, "Node has no parameters to connect to\n");
+        return NULL;
+    }
+
+    Connection *conn = connect_nodes(graph, src, dest);
+    if (!conn) {return NULL;}
+    conn->parameterId = parameterId;
+    dest->numParameterInputs++;
+    return conn;
 }
 
 void init_graph(AudioGraph *graph, int sampleRate, int bufferSize) {
     if (!graph) {return;}
 
+    // control and event nodes see one sample per control period; the period
+    // is lowered until it divides the sample rate so their rate is exact
+    int period = graph->controlPeriod > 1 ? graph->controlPeriod : 1;
+    while (sampleRate % period != 0) {period--;}
+    graph->effectiveControlPeriod = period;
+    const int controlRate = sampleRate / period;
+    const int maxTicks = bufferSize / period + 1;
+    graph->controlPhase = 0;
+
+    free(graph->controlInput);
+    free(graph->controlOutput);
+    graph->controlInput = (float*)calloc(maxTicks, sizeof(float));
+    graph->controlOutput = (float*)calloc(maxTicks, sizeof(float));
+    if (!graph->controlInput || !graph->controlOutput) {
+        fprintf(stderr, "Failed to allocate control buffers\n");
+        return;
+    }
+
+    free(graph->scratch);
+    graph->scratch = (float*)calloc(bufferSize, sizeof(float));
+    if (!graph->scratch) {
+        fprintf(stderr, "Failed to allocate scratch buffer\n");
+        return;
+    }
+
     for (int i = 0; i < graph->numNodes; i++){
         AudioNode* node = graph->nodes[i];
 
         if (node->interface->init) {
-            node->interface->init(node->instance, sampleRate, bufferSize);
+            if (node->rate == MODULE_RATE_AUDIO) {
+                node->interface->init(node->instance, sampleRate, bufferSize);
+            } else {
+                node->interface->init(node->instance, controlRate, maxTicks);
+            }
         }
+        node->rampFrom = 0.0f;
+        node->rampTo = 0.0f;
+        node->rampPos = period;
+        node->rampStarted = false;
+        node->settledSamples = 0;
+        node->dirty = true;
+
+        // a compact node's outputBuffer pointed at the old scratch buffer
+        if (node->outputFormat != SAMPLE_FORMAT_FLOAT) {node->outputBuffer = NULL;}
+        node->outputFormat = output_format(node);
 
         node->inputBuffer = realloc(node->inputBuffer, bufferSize*sizeof(float));
-        node->outputBuffer = realloc(node->outputBuffer, bufferSize*sizeof(float));
+        if (node->outputFormat == SAMPLE_FORMAT_FLOAT) {
+            node->outputBuffer = realloc(node->outputBuffer, bufferSize*sizeof(float));
+            free(node->compactOutput);
+            node->compactOutput = NULL;
+        } else {
+            free(node->outputBuffer);
+            node->outputBuffer = graph->scratch;
+            node->compactOutput = realloc(node->compactOutput, bufferSize*sample_format_size(node->outputFormat));
+        }
 
-        if (!node->inputBuffer || !node->outputBuffer) {
+        if (!node->inputBuffer || !node->outputBuffer ||
+            (node->outputFormat != SAMPLE_FORMAT_FLOAT && !node->compactOutput)) {
             fprintf(stderr,"Failed to allocate node buffers\n"); 
             return;
         }
         memset(node->inputBuffer, 0, bufferSize*sizeof(float));
         memset(node->outputBuffer, 0, bufferSize*sizeof(float));
+        if (node->compactOutput) {
+            memset(node->compactOutput, 0, bufferSize*sample_format_size(node->outputFormat));
+        }
+    }
+
+    // routed parameters are set again from the first tick
+    for (int i = 0; i < graph->numConnections; i++) {
+        graph->connections[i]->lastValue = NAN;
+    }
+
+    free(graph->processingOrder);
+    graph->processingOrder = topological_sort(graph);
+    if (!graph->processingOrder) {
+        fprintf(stderr, "Graph contains cycles or sorting failures, using insertion order\n");
+    }
+
+    free_steps(graph);
+    if (!build_steps(graph, graph->processingOrder ? graph->processingOrder : graph->nodes)) {
+        fprintf(stderr, "Failed to build processing steps, running nodes unfused\n");
+        free_steps(graph);
     }
-    //graph->nodes = topological_sort(graph);
 }
 
 void process_graph(AudioGraph *graph, int numSamples) {
     if (!graph || numSamples == 0) {return;}
     
-    //AudioNode** processing_order = topological_sort(graph);
-    //if (!processing_order) {
-    //    fprintf(stderr, "Graph contains cycles or sorting failures");
-    //    return;
-    //}
+    if (!graph->steps) {
+        AudioNode **order = graph->processingOrder ? graph->processingOrder : graph->nodes;
+        for (int i = 0; i < graph->numNodes; i++) {
+            run_node(graph, order[i], numSamples);
+            store_output(order[i], numSamples);
+        }
+        graph->controlPhase = (graph->controlPhase + numSamples) % graph->effectiveControlPeriod;
+        return;
+    }
 
-    for (int i = 0; i<graph->numNodes; i++) {
-        AudioNode *node = graph->nodes[i];
+    for (int i = 0; i < graph->numSteps; i++) {
+        ProcessingStep *step = &graph->steps[i];
+        AudioNode *head = step->nodes[0];
+
+        if (step->numNodes == 1) {
+            run_node(graph, head, numSamples);
+            store_output(head, numSamples);
+            continue;
+        }
+
+        // the whole chain runs in place on the last node's output, so the
+        // intermediate buffers are never touched
+        AudioNode *tail = step->nodes[step->numNodes - 1];
+        float *buffer = tail->outputBuffer;
+        mix_inputs(head, buffer, numSamples);
+        for (int offset = 0; offset < numSamples; offset += FUSION_CHUNK_SIZE) {
+            const int chunk = numSamples - offset < FUSION_CHUNK_SIZE ? numSamples - offset : FUSION_CHUNK_SIZE;
+            for (int j = 0; j < step->numNodes; j++) {
+                AudioNode *node = step->nodes[j];
+                node->interface->processInPlace(node->instance, buffer + offset, chunk);
+            }
+        }
+        store_output(tail, numSamples);
+    }
+    graph->controlPhase = (graph->controlPhase + numSamples) % graph->effectiveControlPeriod;
+}
 
-        memset(node->inputBuffer, 0, numSamples*sizeof(float));
+void set_node_parameter(AudioNode *node, int parameterId, float value) {
+    if (!node || !node->interface->setParameter) {return;}
 
-        const float inputScale = 1.0f / (node->numIncoming);
+    node->interface->setParameter(node->instance, parameterId, value);
+    node->dirty = true;
+}
+
+// advances the node's ramp over count samples of its output
+static void fill_ramp(AudioNode *node, float *output, int count, int period) {
+    const float delta = (node->rampTo - node->rampFrom) / period;
+    int i = 0;
+    for (; i < count && node->rampPos < period - 1; i++) {
+        node->rampPos++;
+        output[i] = node->rampFrom + delta * node->rampPos;
+    }
+    if (i < count) {node->rampPos = period;}
+    for (; i < count; i++) {
+        output[i] = node->rampTo;
+    }
+}
+
+/*
+ * Runs a control or event rate node on its inputs sampled at each tick,
+ * one output value per tick, then ramps the output buffer linearly to
+ * every new value over the following control period. Control ticks fall
+ * on multiples of the period in the graph's sample clock; an event node
+ * ticks at the start of the first block after a parameter change and
+ * otherwise leaves its settled output alone, unless a routed parameter
+ * has changed by the start of the block.
+ */
+static void run_control_node(AudioGraph *graph, AudioNode *node, int numSamples) {
+    const int period = graph->effectiveControlPeriod;
+    int first = 0;
+    int numTicks = 0;
+
+    if (node->rate == MODULE_RATE_EVENT && node->numParameterInputs > 0 && apply_parameters(node, 0, false)) {
+        node->dirty = true;
+    }
+
+    if (node->rate == MODULE_RATE_CONTROL) {
+        first = (period - graph->controlPhase) % period;
+        numTicks = first < numSamples ? (numSamples - first - 1) / period + 1 : 0;
+    } else if (node->dirty) {
+        numTicks = 1;
+        node->dirty = false;
+    }
+
+    const bool settled = numTicks == 0 && node->rampPos >= period;
+    if (settled && numSamples <= node->settledSamples) {return;}
+
+    for (int k = 0; k < numTicks; k++) {
+        const int tick = first + k * period;
+        float value = 0.0f;
+        const float inputScale = 1.0f / (node->numIncoming - node->numParameterInputs);
         for (int j = 0; j < node->numIncoming; j++) {
-            Connection *conn = node->incoming[j];
-            AudioNode *src = conn->source;
-            
-            if (!src->outputBuffer) {continue;}
+            if (node->incoming[j]->parameterId >= 0) {continue;}
+            value += sample_output(node->incoming[j]->source, tick) * inputScale;
+        }
+        graph->controlInput[k] = value;
+    }
+    if (numTicks > 0 && node->rate == MODULE_RATE_CONTROL && node->numParameterInputs > 0) {
+        // every tick sees the parameters sampled at that tick
+        for (int k = 0; k < numTicks; k++) {
+            apply_parameters(node, first + k * period, false);
+            node->interface->process(node->instance, graph->controlInput + k, graph->controlOutput + k, 1);
+        }
+    } else if (numTicks > 0) {
+        node->interface->process(node->instance, graph->controlInput, graph->controlOutput, numTicks);
+    }
 
-            for (int k = 0; k < numSamples; k++) {
-                node->inputBuffer[k] += src->outputBuffer[k] * inputScale;
-            }
+    int t = 0;
+    for (int k = 0; k <= numTicks; k++) {
+        const int next = (k < numTicks) ? first + k * period : numSamples;
+        fill_ramp(node, node->outputBuffer + t, next - t, period);
+        t = next;
+
+        if (k < numTicks && !node->rampStarted) {
+            // nothing to ramp from yet, so the first value starts settled
+            node->rampFrom = graph->controlOutput[k];
+            node->rampTo = graph->controlOutput[k];
+            node->rampPos = period;
+            node->rampStarted = true;
+        } else if (k < numTicks) {
+            // a new value interrupts any unfinished ramp from where it got to
+            const float current = node->rampPos >= period ? node->rampTo
+                : node->rampFrom + (node->rampTo - node->rampFrom) / period * node->rampPos;
+            node->rampFrom = current;
+            node->rampTo = graph->controlOutput[k];
+            node->rampPos = 0;
+        }
+    }
+    // a buffer written with nothing but the settled value stays valid
+    node->settledSamples = settled ? numSamples : 0;
+}
+
+static void run_node(AudioGraph *graph, AudioNode *node, int numSamples) {
+    if (node->rate != MODULE_RATE_AUDIO) {
+        run_control_node(graph, node, numSamples);
+        return;
+    }
+    mix_inputs(node, node->inputBuffer, numSamples);
+    if (node->numParameterInputs == 0) {
+        node->interface->process(node->instance, node->inputBuffer, node->outputBuffer, numSamples);
+        return;
+    }
+
+    // routed parameters change on control ticks, so the block is processed
+    // in pieces that start at each tick
+    const int period = graph->effectiveControlPeriod;
+    int tick = (period - graph->controlPhase) % period;
+    if (tick > 0) {apply_parameters(node, 0, true);}
+
+    int start = 0;
+    while (start < numSamples) {
+        if (start == tick) {
+            apply_parameters(node, tick, false);
+            tick += period;
+        }
+        const int end = tick < numSamples ? tick : numSamples;
+        node->interface->process(node->instance, node->inputBuffer + start, node->outputBuffer + start, end - start);
+        start = end;
+    }
+}
+
+// one sample of a node's output, widened from its compact storage if needed
+static float sample_output(const AudioNode *node, int index) {
+    if (node->outputFormat == SAMPLE_FORMAT_INT16) {
+        return int16_sample(((const int16_t*)node->compactOutput)[index]);
+    }
+    if (node->outputFormat == SAMPLE_FORMAT_HALF) {
+        return half_sample(((const uint16_t*)node->compactOutput)[index]);
+    }
+    return node->outputBuffer ? node->outputBuffer[index] : 0.0f;
+}
+
+/*
+ * Hands the node every routed parameter whose source differs at index
+ * from the value last set, or with onlyNew only those never set yet.
+ * Returns whether any parameter changed.
+ */
+static bool apply_parameters(AudioNode *node, int index, bool onlyNew) {
+    bool changed = false;
+    for (int j = 0; j < node->numIncoming; j++) {
+        Connection *conn = node->incoming[j];
+        if (conn->parameterId < 0 || (onlyNew && !isnan(conn->lastValue))) {continue;}
+
+        const float value = sample_output(conn->source, index);
+        if (value != conn->lastValue) {
+            node->interface->setParameter(node->instance, conn->parameterId, value);
+            conn->lastValue = value;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+static void mix_inputs(AudioNode *node, float *buffer, int numSamples) {
+    memset(buffer, 0, numSamples*sizeof(float));
+
+    const float inputScale = 1.0f / (node->numIncoming - node->numParameterInputs);
+    for (int j = 0; j < node->numIncoming; j++) {
+        Connection *conn = node->incoming[j];
+        AudioNode *src = conn->source;
+        if (conn->parameterId >= 0) {continue;}
+
+        // compact outputs are widened back to float while they are mixed
+        if (src->outputFormat == SAMPLE_FORMAT_INT16) {
+            int16_accumulate((const int16_t*)src->compactOutput, buffer, inputScale, numSamples);
+            continue;
+        }
+        if (src->outputFormat == SAMPLE_FORMAT_HALF) {
+            half_accumulate((const uint16_t*)src->compactOutput, buffer, inputScale, numSamples);
+            continue;
         }
+        if (!src->outputBuffer) {continue;}
 
-        node->interface->process(node->instance, 
-                                 node->inputBuffer,
-                                 node->outputBuffer,
-                                 numSamples);
+        for (int k = 0; k < numSamples; k++) {
+            buffer[k] += src->outputBuffer[k] * inputScale;
+        }
+    }
+}
+
+/*
+ * Only audio nodes are stored compactly: control and event nodes may skip
+ * a block and leave their previous output in place, which the shared
+ * scratch buffer cannot hold for them.
+ */
+static SampleFormat output_format(AudioNode *node) {
+    if (node->rate != MODULE_RATE_AUDIO || node->numOutgoing == 0) {return SAMPLE_FORMAT_FLOAT;}
+
+    const SampleFormat format = node->outgoing[0]->format;
+    for (int i = 1; i < node->numOutgoing; i++) {
+        if (node->outgoing[i]->format != format) {return SAMPLE_FORMAT_FLOAT;}
+    }
+    return format;
+}
+
+// narrows a compact node's output out of the scratch buffer
+static void store_output(AudioNode *node, int numSamples) {
+    if (node->outputFormat == SAMPLE_FORMAT_INT16) {
+        float_to_int16(node->outputBuffer, (int16_t*)node->compactOutput, numSamples);
+    } else if (node->outputFormat == SAMPLE_FORMAT_HALF) {
+        float_to_half(node->outputBuffer, (uint16_t*)node->compactOutput, numSamples);
+    }
+}
+
+static bool can_fuse(AudioNode *node) {
+    return node->rate == MODULE_RATE_AUDIO && node->numParameterInputs == 0 &&
+           node->interface->processInPlace != NULL;
+}
+
+// the node a chain can continue into: its only consumer, fed by nothing else
+static AudioNode* fusion_successor(AudioNode *node) {
+    if (!can_fuse(node) || node->numOutgoing != 1) {return NULL;}
+
+    AudioNode *next = node->outgoing[0]->destination;
+    if (next->numIncoming != 1 || !can_fuse(next)) {return NULL;}
+    return next;
+}
 
+/*
+ * Walks the processing order and groups each maximal run of fusable nodes
+ * linked one-to-one into a single step, placed where its head sits in the
+ * order. Inner nodes only read their predecessor and only feed their
+ * successor, so running the chain back to back keeps the order valid.
+ */
+static bool build_steps(AudioGraph *graph, AudioNode **order) {
+    if (graph->numNodes == 0) {return true;}
+
+    graph->steps = (ProcessingStep*)calloc(graph->numNodes, sizeof(ProcessingStep));
+    bool *placed = (bool*)calloc(graph->numNodes, sizeof(bool));
+    if (!graph->steps || !placed) {
+        free(placed);
+        return false;
     }
 
-    //free(processing_order);
+    bool ok = true;
+    for (int i = 0; i < graph->numNodes; i++) {
+        if (placed[i]) {continue;}
+
+        ProcessingStep *step = &graph->steps[graph->numSteps++];
+        step->nodes = (AudioNode**)malloc(graph->numNodes*sizeof(AudioNode*));
+        if (!step->nodes) {
+            ok = false;
+            break;
+        }
+        step->nodes[step->numNodes++] = order[i];
+        placed[i] = true;
+
+        AudioNode *next = graph->fuseChains ? fusion_successor(order[i]) : NULL;
+        while (next) {
+            int index = -1;
+            for (int j = i + 1; j < graph->numNodes; j++) {
+                if (order[j] == next) {
+                    index = j;
+                    break;
+                }
+            }
+            if (index == -1 || placed[index]) {break;}
+
+            step->nodes[step->numNodes++] = next;
+            placed[index] = true;
+            next = fusion_successor(next);
+        }
+    }
+
+    free(placed);
+    return ok;
+}
+
+static void free_steps(AudioGraph *graph) {
+    for (int i = 0; i < graph->numSteps; i++) {
+        free(graph->steps[i].nodes);
+    }
+    free(graph->steps);
+    graph->steps = NULL;
+    graph->numSteps = 0;
 }
 
 static void free_node(AudioNode *node) {
@@ -173,9 +578,11 @@ static void free_node(AudioNode *node) {
         node->interface->destroy(node->instance);
     }
     free(node->inputBuffer);
-    free(node->outputBuffer);
+    if (node->outputFormat == SAMPLE_FORMAT_FLOAT) {free(node->outputBuffer);}
+    free(node->compactOutput);
     free(node->incoming);
     free(node->outgoing);
+    free(node);
 }
 
 static void free_connection(Connection *conn) {
@@ -217,7 +624,7 @@ static AudioNode** topological_sort(AudioGraph *graph) {
             Connection *conn = graph->nodes[current]->outgoing[i];
 
             int destIndex = -1;
-            for (int j=0; j<graph->numNodes; i++) {
+            for (int j=0; j<graph->numNodes; j++) {
                 if (graph->nodes[j] == conn->destination) {
                     destIndex = j;
                     break;
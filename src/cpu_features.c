@@ -0,0 +1,41 @@
+#include "cpu_features.h"
+
+bool cpu_has_ssse3(void) {
+#if defined(__SSSE3__)
+    return true;
+#elif defined(CPU_FEATURES_DISPATCH)
+    return __builtin_cpu_supports("ssse3");
+#else
+    return false;
+#endif
+}
+
+bool cpu_has_avx(void) {
+#if defined(__AVX__)
+    return true;
+#elif defined(CPU_FEATURES_DISPATCH)
+    return __builtin_cpu_supports("avx");
+#else
+    return false;
+#endif
+}
+
+bool cpu_has_fma(void) {
+#if defined(__AVX__) && defined(__FMA__)
+    return true;
+#elif defined(CPU_FEATURES_DISPATCH)
+    return __builtin_cpu_supports("avx") && __builtin_cpu_supports("fma");
+#else
+    return false;
+#endif
+}
+
+bool cpu_has_f16c(void) {
+#if defined(__AVX__) && defined(__F16C__)
+    return true;
+#elif defined(CPU_FEATURES_DISPATCH)
+    return __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+#else
+    return false;
+#endif
+}
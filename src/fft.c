@@ -0,0 +1,237 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "cpu_features.h"
+
+#if defined(__SSE__) || defined(CPU_FEATURES_DISPATCH)
+#include <immintrin.h>
+#endif
+
+#include "fft.h"
+
+static void complex_fft(RealFFT *fft, float *re, float *im, int inverse);
+
+RealFFT* create_real_fft(int size) {
+    if (size < 2 || (size & (size - 1)) != 0) {
+        fprintf(stderr, "FFT size must be a power of two\n");
+        return NULL;
+    }
+
+    RealFFT *fft = (RealFFT*)calloc(1, sizeof(RealFFT));
+    if (!fft) {
+        fprintf(stderr, "Failed to allocate fft\n");
+        return NULL;
+    }
+    fft->size = size;
+    fft->half = size / 2;
+
+    const int half = fft->half;
+    fft->bitReverse = (int*)malloc(half * sizeof(int));
+    fft->twiddleRe = (float*)malloc((half / 2 + 1) * sizeof(float));
+    fft->twiddleIm = (float*)malloc((half / 2 + 1) * sizeof(float));
+    fft->splitRe = (float*)malloc((half + 1) * sizeof(float));
+    fft->splitIm = (float*)malloc((half + 1) * sizeof(float));
+    fft->workRe = (float*)malloc(half * sizeof(float));
+    fft->workIm = (float*)malloc(half * sizeof(float));
+
+    if (!fft->bitReverse || !fft->twiddleRe || !fft->twiddleIm ||
+        !fft->splitRe || !fft->splitIm || !fft->workRe || !fft->workIm) {
+        fprintf(stderr, "Failed to allocate fft tables\n");
+        destroy_real_fft(fft);
+        return NULL;
+    }
+
+    int bits = 0;
+    while ((1 << bits) < half) {bits++;}
+    for (int i = 0; i < half; i++) {
+        int r = 0;
+        for (int b = 0; b < bits; b++) {
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        fft->bitReverse[i] = r;
+    }
+
+    // twiddles for the half-size complex transform
+    for (int k = 0; k <= half / 2; k++) {
+        const double angle = -2.0 * M_PI * k / half;
+        fft->twiddleRe[k] = (float)cos(angle);
+        fft->twiddleIm[k] = (float)sin(angle);
+    }
+
+    // twiddles for splitting the packed transform into the real spectrum
+    for (int k = 0; k <= half; k++) {
+        const double angle = -2.0 * M_PI * k / size;
+        fft->splitRe[k] = (float)cos(angle);
+        fft->splitIm[k] = (float)sin(angle);
+    }
+    return fft;
+}
+
+void destroy_real_fft(RealFFT *fft) {
+    if (!fft) {return;}
+
+    free(fft->bitReverse);
+    free(fft->twiddleRe);
+    free(fft->twiddleIm);
+    free(fft->splitRe);
+    free(fft->splitIm);
+    free(fft->workRe);
+    free(fft->workIm);
+    free(fft);
+}
+
+void real_fft_forward(RealFFT *fft, const float *input, float *re, float *im) {
+    const int half = fft->half;
+    float *zr = fft->workRe;
+    float *zi = fft->workIm;
+
+    // pack even samples into the real part and odd samples into the imaginary part
+    for (int k = 0; k < half; k++) {
+        const int r = fft->bitReverse[k];
+        zr[r] = input[2 * k];
+        zi[r] = input[2 * k + 1];
+    }
+
+    complex_fft(fft, zr, zi, 0);
+
+    for (int k = 0; k <= half; k++) {
+        const int a = (k == half) ? 0 : k;
+        const int b = (k == 0) ? 0 : half - k;
+
+        const float ar = zr[a], ai = zi[a];
+        const float br = zr[b], bi = -zi[b];
+
+        const float evenRe = 0.5f * (ar + br);
+        const float evenIm = 0.5f * (ai + bi);
+        const float oddRe = 0.5f * (ai - bi);
+        const float oddIm = -0.5f * (ar - br);
+
+        const float wr = fft->splitRe[k];
+        const float wi = fft->splitIm[k];
+        re[k] = evenRe + wr * oddRe - wi * oddIm;
+        im[k] = evenIm + wr * oddIm + wi * oddRe;
+    }
+}
+
+void real_fft_inverse(RealFFT *fft, const float *re, const float *im, float *output) {
+    const int half = fft->half;
+    float *zr = fft->workRe;
+    float *zi = fft->workIm;
+
+    for (int k = 0; k < half; k++) {
+        const float ar = re[k], ai = im[k];
+        const float br = re[half - k], bi = -im[half - k];
+
+        const float evenRe = 0.5f * (ar + br);
+        const float evenIm = 0.5f * (ai + bi);
+        const float diffRe = 0.5f * (ar - br);
+        const float diffIm = 0.5f * (ai - bi);
+
+        // odd = diff * conj(w)
+        const float wr = fft->splitRe[k];
+        const float wi = fft->splitIm[k];
+        const float oddRe = diffRe * wr + diffIm * wi;
+        const float oddIm = diffIm * wr - diffRe * wi;
+
+        const int r = fft->bitReverse[k];
+        zr[r] = evenRe - oddIm;
+        zi[r] = evenIm + oddRe;
+    }
+
+    complex_fft(fft, zr, zi, 1);
+
+    const float scale = 1.0f / half;
+    for (int k = 0; k < half; k++) {
+        output[2 * k] = zr[k] * scale;
+        output[2 * k + 1] = zi[k] * scale;
+    }
+}
+
+#if defined(CPU_FEATURES_DISPATCH)
+// returns how many bins it covered, leaving the tail to the caller
+__attribute__((target("avx,fma")))
+static int multiply_accumulate_fma(float *accRe, float *accIm,
+                                   const float *aRe, const float *aIm,
+                                   const float *bRe, const float *bIm,
+                                   int numBins) {
+    int i = 0;
+    for (; i + 8 <= numBins; i += 8) {
+        const __m256 ar = _mm256_loadu_ps(aRe + i);
+        const __m256 ai = _mm256_loadu_ps(aIm + i);
+        const __m256 br = _mm256_loadu_ps(bRe + i);
+        const __m256 bi = _mm256_loadu_ps(bIm + i);
+        __m256 cr = _mm256_loadu_ps(accRe + i);
+        __m256 ci = _mm256_loadu_ps(accIm + i);
+        cr = _mm256_fmadd_ps(ar, br, cr);
+        cr = _mm256_fnmadd_ps(ai, bi, cr);
+        ci = _mm256_fmadd_ps(ar, bi, ci);
+        ci = _mm256_fmadd_ps(ai, br, ci);
+        _mm256_storeu_ps(accRe + i, cr);
+        _mm256_storeu_ps(accIm + i, ci);
+    }
+    return i;
+}
+#endif
+
+void complex_multiply_accumulate(float *accRe, float *accIm,
+                                 const float *aRe, const float *aIm,
+                                 const float *bRe, const float *bIm,
+                                 int numBins) {
+    int i = 0;
+
+#if defined(CPU_FEATURES_DISPATCH)
+    if (cpu_has_fma()) {
+        i = multiply_accumulate_fma(accRe, accIm, aRe, aIm, bRe, bIm, numBins);
+    }
+#endif
+
+#if defined(__SSE__)
+    for (; i + 4 <= numBins; i += 4) {
+        const __m128 ar = _mm_loadu_ps(aRe + i);
+        const __m128 ai = _mm_loadu_ps(aIm + i);
+        const __m128 br = _mm_loadu_ps(bRe + i);
+        const __m128 bi = _mm_loadu_ps(bIm + i);
+        __m128 cr = _mm_loadu_ps(accRe + i);
+        __m128 ci = _mm_loadu_ps(accIm + i);
+        cr = _mm_add_ps(cr, _mm_sub_ps(_mm_mul_ps(ar, br), _mm_mul_ps(ai, bi)));
+        ci = _mm_add_ps(ci, _mm_add_ps(_mm_mul_ps(ar, bi), _mm_mul_ps(ai, br)));
+        _mm_storeu_ps(accRe + i, cr);
+        _mm_storeu_ps(accIm + i, ci);
+    }
+#endif
+
+    for (; i < numBins; i++) {
+        accRe[i] += aRe[i] * bRe[i] - aIm[i] * bIm[i];
+        accIm[i] += aRe[i] * bIm[i] + aIm[i] * bRe[i];
+    }
+}
+
+// in-place radix-2 transform; expects input already in bit-reversed order
+static void complex_fft(RealFFT *fft, float *re, float *im, int inverse) {
+    const int n = fft->half;
+    const float sign = inverse ? -1.0f : 1.0f;
+
+    for (int size = 2; size <= n; size <<= 1) {
+        const int halfSize = size >> 1;
+        const int step = n / size;
+
+        for (int start = 0; start < n; start += size) {
+            for (int j = 0; j < halfSize; j++) {
+                const float wr = fft->twiddleRe[j * step];
+                const float wi = sign * fft->twiddleIm[j * step];
+
+                const int a = start + j;
+                const int b = a + halfSize;
+
+                const float tr = wr * re[b] - wi * im[b];
+                const float ti = wr * im[b] + wi * re[b];
+
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
@@ -0,0 +1,229 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "graph_host.h"
+#include "output_module.h"
+
+/*
+ * Workers pick, among the idle sessions whose next block has been
+ * released, the one with the earliest deadline (EDF). Every session
+ * advances its deadline by one period per block, so this is round-robin
+ * when all keep up and spreads lateness evenly when the pool is
+ * overloaded. A sink that refuses a block pushes its session back: the
+ * block is kept and offered again a period later, and the schedule slips
+ * with it, so a consumer running slower than our clock paces the session
+ * instead of losing blocks.
+ */
+
+static void* host_worker(void *args);
+static int64_t now_ns(void);
+static struct timespec to_timespec(int64_t ns);
+
+GraphHost* create_graph_host(int numWorkers) {
+    if (numWorkers < 1) {numWorkers = 1;}
+
+    GraphHost *host = (GraphHost*)calloc(1, sizeof(GraphHost));
+    if (!host) {
+        fprintf(stderr, "Failed to allocate graph host\n");
+        return NULL;
+    }
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&host->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_cond_init(&host->idle, NULL);
+    pthread_mutex_init(&host->lock, NULL);
+
+    host->workers = (pthread_t*)malloc(numWorkers * sizeof(pthread_t));
+    if (!host->workers) {
+        fprintf(stderr, "Failed to allocate graph host workers\n");
+        destroy_graph_host(host);
+        return NULL;
+    }
+
+    host->running = true;
+    for (int i = 0; i < numWorkers; i++) {
+        if (pthread_create(&host->workers[i], NULL, host_worker, host) != 0) {
+            fprintf(stderr, "Failed to start graph host worker\n");
+            destroy_graph_host(host);
+            return NULL;
+        }
+        host->numWorkers++;
+    }
+    return host;
+}
+
+void destroy_graph_host(GraphHost *host) {
+    if (!host) {return;}
+
+    pthread_mutex_lock(&host->lock);
+    host->running = false;
+    pthread_cond_broadcast(&host->cond);
+    pthread_mutex_unlock(&host->lock);
+
+    for (int i = 0; i < host->numWorkers; i++) {
+        pthread_join(host->workers[i], NULL);
+    }
+    for (int i = 0; i < host->numSessions; i++) {
+        free(host->sessions[i]);
+    }
+
+    free(host->workers);
+    free(host->sessions);
+    pthread_mutex_destroy(&host->lock);
+    pthread_cond_destroy(&host->cond);
+    pthread_cond_destroy(&host->idle);
+    free(host);
+}
+
+GraphSession* add_graph_session(GraphHost *host, AudioGraph *graph, AudioNode *output,
+                                int sampleRate, int blockSize, int latencyBlocks,
+                                GraphSink sink, void *sinkData) {
+    if (!host || !graph || !output || !sink || sampleRate <= 0 || blockSize <= 0) {return NULL;}
+    if (latencyBlocks < 1) {latencyBlocks = 1;}
+
+    GraphSession *session = (GraphSession*)calloc(1, sizeof(GraphSession));
+    if (!session) {
+        fprintf(stderr, "Failed to allocate graph session\n");
+        return NULL;
+    }
+    session->graph = graph;
+    session->output = output;
+    session->sink = sink;
+    session->sinkData = sinkData;
+    session->blockSize = blockSize;
+    session->periodNs = (int64_t)blockSize * 1000000000LL / sampleRate;
+    session->leadNs = session->periodNs * latencyBlocks;
+
+    pthread_mutex_lock(&host->lock);
+
+    GraphSession **sessions = realloc(host->sessions, (host->numSessions + 1) * sizeof(GraphSession*));
+    if (!sessions) {
+        fprintf(stderr, "Failed to expand session array\n");
+        pthread_mutex_unlock(&host->lock);
+        free(session);
+        return NULL;
+    }
+    host->sessions = sessions;
+
+    // the first latencyBlocks blocks are released at once to fill the lead
+    session->deadlineNs = now_ns() + session->periodNs;
+    host->sessions[host->numSessions++] = session;
+
+    pthread_cond_broadcast(&host->cond);
+    pthread_mutex_unlock(&host->lock);
+    return session;
+}
+
+void remove_graph_session(GraphHost *host, GraphSession *session) {
+    if (!host || !session) {return;}
+
+    pthread_mutex_lock(&host->lock);
+    for (int i = 0; i < host->numSessions; i++) {
+        if (host->sessions[i] == session) {
+            host->sessions[i] = host->sessions[--host->numSessions];
+            break;
+        }
+    }
+    while (session->busy) {
+        pthread_cond_wait(&host->idle, &host->lock);
+    }
+    pthread_mutex_unlock(&host->lock);
+
+    free(session);
+}
+
+static void* host_worker(void *args) {
+    GraphHost *host = (GraphHost*)args;
+
+    pthread_mutex_lock(&host->lock);
+    while (host->running) {
+        const int64_t now = now_ns();
+        GraphSession *next = NULL;
+        int64_t earliestRelease = INT64_MAX;
+
+        for (int i = 0; i < host->numSessions; i++) {
+            GraphSession *session = host->sessions[i];
+            if (session->busy) {continue;}
+
+            const int64_t release = session->deadlineNs - session->leadNs;
+            if (release > now) {
+                if (release < earliestRelease) {earliestRelease = release;}
+                continue;
+            }
+            if (!next || session->deadlineNs < next->deadlineNs) {
+                next = session;
+            }
+        }
+
+        if (!next) {
+            if (earliestRelease == INT64_MAX) {
+                pthread_cond_wait(&host->cond, &host->lock);
+            } else {
+                const struct timespec until = to_timespec(earliestRelease);
+                pthread_cond_timedwait(&host->cond, &host->lock, &until);
+            }
+            continue;
+        }
+
+        next->busy = true;
+        const bool render = !next->pending;
+        pthread_mutex_unlock(&host->lock);
+
+        // a refused block is still in the output node, since nothing rendered since
+        if (render) {
+            process_graph(next->graph, next->blockSize);
+        }
+        OutputNode *out = (OutputNode*)next->output->instance;
+        const bool accepted = next->sink(next->sinkData, out->outputs[0], next->blockSize);
+
+        pthread_mutex_lock(&host->lock);
+        const int64_t finished = now_ns();
+        next->busy = false;
+        if (render) {next->blocksRendered++;}
+        next->pending = !accepted;
+
+        if (!accepted) {
+            next->sinkStalls++;
+            // offer it again once the consumer has had a period to make room
+            const int64_t retry = finished + next->periodNs;
+            if (next->deadlineNs - next->leadNs < retry) {
+                next->deadlineNs = retry + next->leadNs;
+            }
+        } else {
+            if (finished > next->deadlineNs) {
+                next->deadlineMisses++;
+            }
+
+            next->deadlineNs += next->periodNs;
+            // already late for the next block as well: resume pacing instead of bursting
+            if (next->deadlineNs < finished) {
+                next->deadlineNs = finished + next->leadNs;
+            }
+        }
+
+        // this worker rescans on its own; one more covers a release the
+        // sleeping workers did not see while the session was busy
+        pthread_cond_signal(&host->cond);
+        pthread_cond_broadcast(&host->idle);
+    }
+    pthread_mutex_unlock(&host->lock);
+    return NULL;
+}
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static struct timespec to_timespec(int64_t ns) {
+    struct timespec ts;
+    ts.tv_sec = ns / 1000000000LL;
+    ts.tv_nsec = ns % 1000000000LL;
+    return ts;
+}
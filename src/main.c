@@ -2,13 +2,16 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdint.h>
-#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 #include <portaudio.h>
 #include <pthread.h>
 #include <stdlib.h>
 
 #include "audio_graph.h"
+#include "graph_host.h"
+#include "resampler.h"
+#include "ring_buffer.h"
 #include "sine_osc_module.h"
 #include "lowpass_filter_module.h"
 #include "output_module.h"
@@ -20,93 +23,37 @@
 #define MOD_FREQ    10.0f
 #define MOD_DEPTH   0.5f
 #define FRAMES_PER_BUFFER 128
-#define RING_BUFFER_SIZE (FRAMES_PER_BUFFER * 8+1)
-
-/* ATOMIC RINGBUFFER*/
-
-typedef struct {
-    float *buffer;
-    int size;
-    atomic_int readPos;
-    atomic_int writePos;
-} AtomicRingBuffer ;
-
-static void initAtomicRingBuffer(AtomicRingBuffer *rb, int size) {
-    rb->buffer = (float*)malloc(size* sizeof(float));
-    rb->size = size;
-    atomic_init(&rb->readPos, 0);
-    atomic_init(&rb->writePos, 0);
-}
-
-static void freeAtomicRingBuffer(AtomicRingBuffer *rb) {
-    free(rb->buffer);
-}
-
-static bool writeAtomicRingBuffer(AtomicRingBuffer *rb, float *data, int numSamples) {
-    int readPos = atomic_load_explicit(&rb->readPos, memory_order_acquire);
-    int writePos = atomic_load_explicit(&rb->writePos, memory_order_relaxed);
-    
-    int available = (readPos > writePos) ? (readPos - writePos) : (rb->size - writePos + readPos);
-
-    if (available < numSamples) return false;
-
-    int spaceToEnd = rb->size - writePos;
-
-    if (spaceToEnd >= numSamples) {
-        memcpy(&rb->buffer[writePos], data, numSamples * sizeof(float));
-    } else {
-        memcpy(&rb->buffer[writePos], data, spaceToEnd * sizeof(float));
-        memcpy(&rb->buffer[0], &data[spaceToEnd], (numSamples - spaceToEnd) * sizeof(float));
-    }
-
-    atomic_store_explicit(&rb->writePos, (writePos + numSamples) % rb->size, memory_order_release);
-    return true;
-}
-
-static bool readAtomicRingBuffer(AtomicRingBuffer *rb, float *data, int numSamples) {
-    int readPos = atomic_load_explicit(&rb->readPos, memory_order_relaxed);
-    int writePos = atomic_load_explicit(&rb->writePos, memory_order_acquire);
-
-    int available = (writePos >= readPos) ? (writePos - readPos) : (rb->size -readPos + writePos);
-
-    if (available < numSamples) return false;
-
-    int spaceToEnd = rb->size - readPos;
+#define RING_BUFFER_SIZE (FRAMES_PER_BUFFER * 8)
+#define LATENCY_BLOCKS 4
 
-    if (spaceToEnd >= numSamples) {
-        memcpy(data, &rb->buffer[readPos], numSamples * sizeof(float));
-    } else {
-        memcpy(data, &rb->buffer[readPos], spaceToEnd * sizeof(float));
-        memcpy(&data[spaceToEnd], &rb->buffer[0], (numSamples - spaceToEnd) * sizeof(float));
-    }
-
-    atomic_store_explicit(&rb->readPos, (readPos + numSamples) % rb->size, memory_order_release);
-    return true;
-}
-
-AtomicRingBuffer rb;
+RingBuffer *rb;
+// callbacks that found the ring empty and repeated the last buffer
+atomic_int deviceUnderruns;
 
 /***********************/
-/* AUDIO PROCESSING THREAD */
-
-volatile bool running = true;
-
-static void* audioProcessingThread(void *args) {
-
-    AudioGraph* graph = (AudioGraph*)args;
-
-    OutputNode* out = (OutputNode*)graph->nodes[graph->numNodes-1]->instance;
-
-    while (running) {
-
-        process_graph(graph, FRAMES_PER_BUFFER);
+/* GRAPH OUTPUT SINK */
 
-        while (!writeAtomicRingBuffer(&rb, out->outputs[0], FRAMES_PER_BUFFER) && running) {
-            //buffer is full
-            Pa_Sleep(1);
-        }
+typedef struct {
+    RingBuffer *ring;
+    // converts engine blocks to the device rate, NULL when the rates match
+    Resampler *resampler;
+    float *converted;
+    int convertedSize;
+} DeviceSink;
+
+// a full ring means the device clock runs slower than ours; refusing makes the host hold the block
+static bool deviceSink(void *userData, const float *samples, int numSamples) {
+    DeviceSink *sink = (DeviceSink*)userData;
+    if (!sink->resampler) {
+        return ring_buffer_write(sink->ring, samples, numSamples);
+    }
+    // check for room first, the resampler consumes its input either way
+    if (ring_buffer_write_available(sink->ring) < resampler_max_output(sink->resampler, numSamples)) {
+        return false;
     }
-    return NULL;
+    const int numConverted = resampler_process(sink->resampler, samples, numSamples,
+                                               sink->converted, sink->convertedSize);
+    return ring_buffer_write(sink->ring, sink->converted, numConverted);
 }
 /*********************/
 
@@ -137,7 +84,8 @@ static int patestCallback(const void *inputBuffer,
     static bool hasLastBuffer = false; 
 
     // I am not sure about this handling of buffer underflow
-    if (!readAtomicRingBuffer(&rb, out, framesPerBuffer)) {
+    if (!ring_buffer_read(rb, out, framesPerBuffer)) {
+        atomic_fetch_add_explicit(&deviceUnderruns, 1, memory_order_relaxed);
         if (hasLastBuffer) {
             memcpy(out, lastBuffer, framesPerBuffer * sizeof(float));
         } else {
@@ -155,7 +103,7 @@ int main(){
     PaError err;
     PaStream *stream;
 
-    initAtomicRingBuffer(&rb, RING_BUFFER_SIZE);
+    rb = create_ring_buffer(RING_BUFFER_SIZE, 1);
 
     AudioGraph* graph = create_audio_graph();
 
@@ -199,14 +147,36 @@ int main(){
     }
     //printf("PortAudio version: %s\n", Pa_GetVersionText());
 
-    pthread_t audioThread;
-    pthread_create(&audioThread, NULL, audioProcessingThread, graph);
+    // open the device at its own rate and convert at the boundary instead of forcing ours on it
+    int deviceRate = SAMPLE_RATE;
+    const PaDeviceIndex device = Pa_GetDefaultOutputDevice();
+    const PaDeviceInfo *deviceInfo = (device != paNoDevice) ? Pa_GetDeviceInfo(device) : NULL;
+    if (deviceInfo && deviceInfo->defaultSampleRate > 0) {
+        deviceRate = (int)deviceInfo->defaultSampleRate;
+    }
+
+    DeviceSink sink = {rb, NULL, NULL, 0};
+    if (deviceRate != SAMPLE_RATE) {
+        printf("Resampling %d Hz to the device's %d Hz\n", SAMPLE_RATE, deviceRate);
+        sink.resampler = create_resampler(SAMPLE_RATE, deviceRate);
+        if (sink.resampler) {
+            // a block can never yield more than this, whatever the filter holds back
+            sink.convertedSize = (int)((long long)FRAMES_PER_BUFFER * deviceRate / SAMPLE_RATE) + 2;
+            sink.converted = (float*)malloc(sink.convertedSize * sizeof(float));
+        }
+        if (!sink.converted) {
+            fprintf(stderr, "Failed to set up the device resampler\n");
+            destroy_resampler(sink.resampler);
+            Pa_Terminate();
+            return 1;
+        }
+    }
 
     err = Pa_OpenDefaultStream(&stream,
                                0, 
                                1,
                                paFloat32,
-                               SAMPLE_RATE, 
+                               deviceRate, 
                                FRAMES_PER_BUFFER, 
                                patestCallback, 
                                &data);
@@ -224,6 +194,10 @@ int main(){
         return 1;
     }
 
+    GraphHost* host = create_graph_host(1);
+    GraphSession* session = add_graph_session(host, graph, out, SAMPLE_RATE, FRAMES_PER_BUFFER,
+                                              LATENCY_BLOCKS, deviceSink, &sink);
+
     Pa_Sleep(NUM_SECONDS*1000);
 
     sine_osc->interface->setParameter(sine_osc->instance, OSC_FREQUENCY_PARAM, 164.814f);
@@ -233,6 +207,13 @@ int main(){
 
     Pa_Sleep(NUM_SECONDS*1000);
 
+    pthread_mutex_lock(&host->lock);
+    printf("%llu blocks held back by a full buffer, %d device underruns\n",
+           (unsigned long long)session->sinkStalls, atomic_load(&deviceUnderruns));
+    pthread_mutex_unlock(&host->lock);
+    remove_graph_session(host, session);
+    destroy_graph_host(host);
+
     err = Pa_StopStream(stream);
     if(err != paNoError) {
         fprintf(stderr, "PortAudio error (stop): %s\n", Pa_GetErrorText(err));
@@ -254,10 +235,9 @@ int main(){
 
     printf("PortAudio terminated successfully.\n");
 
-    running = false;
-    pthread_cancel(audioThread); 
-    pthread_join(audioThread, NULL);
-    freeAtomicRingBuffer(&rb);
+    destroy_ring_buffer(rb);
+    destroy_resampler(sink.resampler);
+    free(sink.converted);
 
     return 0;
 }
@@ -0,0 +1,126 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mapped_sample.h"
+
+static bool frame_range_to_bytes(const MappedSample *sample, int frame, int numFrames,
+                                 size_t *first, size_t *last);
+
+MappedSample* open_mapped_sample(const char *path) {
+    MappedSample *sample = (MappedSample*)calloc(1, sizeof(MappedSample));
+    if (!sample) {
+        fprintf(stderr, "Failed to allocate mapped sample\n");
+        return NULL;
+    }
+    sample->fd = -1;
+    sample->pageSize = (size_t)sysconf(_SC_PAGESIZE);
+
+    sample->fd = open(path, O_RDONLY);
+    if (sample->fd < 0) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        close_mapped_sample(sample);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(sample->fd, &st) != 0 || st.st_size <= 0) {
+        fprintf(stderr, "Failed to stat %s\n", path);
+        close_mapped_sample(sample);
+        return NULL;
+    }
+    sample->mapSize = (size_t)st.st_size;
+
+    void *map = mmap(NULL, sample->mapSize, PROT_READ, MAP_SHARED, sample->fd, 0);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Failed to map %s\n", path);
+        close_mapped_sample(sample);
+        return NULL;
+    }
+    sample->map = (unsigned char*)map;
+
+    if (!parse_wav_header(sample->map, sample->mapSize, &sample->info)) {
+        close_mapped_sample(sample);
+        return NULL;
+    }
+
+    // mono float32 with an aligned data chunk can be read straight from the mapping
+    if (sample->info.format == WAV_FORMAT_FLOAT32 && sample->info.numChannels == 1 &&
+        sample->info.dataOffset % sizeof(float) == 0) {
+        sample->direct = (const float*)(sample->map + sample->info.dataOffset);
+    }
+    return sample;
+}
+
+void close_mapped_sample(MappedSample *sample) {
+    if (!sample) {return;}
+
+    if (sample->map) {
+        munmap(sample->map, sample->mapSize);
+    }
+    if (sample->fd >= 0) {
+        close(sample->fd);
+    }
+    free(sample);
+}
+
+void mapped_sample_prefetch(MappedSample *sample, int frame, int numFrames) {
+    size_t first, last;
+    if (!frame_range_to_bytes(sample, frame, numFrames, &first, &last)) {return;}
+
+    const size_t start = first & ~(sample->pageSize - 1);
+    madvise(sample->map + start, last - start, MADV_WILLNEED);
+
+    // touch every page so the audio thread never takes the fault itself
+    volatile unsigned char sink = 0;
+    for (size_t offset = start; offset < last; offset += sample->pageSize) {
+        sink += sample->map[offset];
+    }
+    (void)sink;
+}
+
+void mapped_sample_release(MappedSample *sample, int frame, int numFrames) {
+    size_t first, last;
+    if (!frame_range_to_bytes(sample, frame, numFrames, &first, &last)) {return;}
+
+    // only whole pages inside the range, the neighbours may still be playing
+    const size_t start = (first + sample->pageSize - 1) & ~(sample->pageSize - 1);
+    const size_t end = last & ~(sample->pageSize - 1);
+    if (end <= start) {return;}
+
+    madvise(sample->map + start, end - start, MADV_DONTNEED);
+}
+
+void mapped_sample_read(const MappedSample *sample, int frame, int numFrames, float *output) {
+    const WavInfo *info = &sample->info;
+    const unsigned char *frames = sample->map + info->dataOffset + (size_t)frame * info->bytesPerFrame;
+
+    if (sample->direct) {
+        memcpy(output, sample->direct + frame, numFrames * sizeof(float));
+        return;
+    }
+
+    convert_wav_mono(info, frames, output, numFrames);
+}
+
+static bool frame_range_to_bytes(const MappedSample *sample, int frame, int numFrames,
+                                 size_t *first, size_t *last) {
+    const WavInfo *info = &sample->info;
+
+    if (frame < 0) {
+        numFrames += frame;
+        frame = 0;
+    }
+    if (frame + numFrames > info->numFrames) {
+        numFrames = info->numFrames - frame;
+    }
+    if (numFrames <= 0) {return false;}
+
+    *first = info->dataOffset + (size_t)frame * info->bytesPerFrame;
+    *last = *first + (size_t)numFrames * info->bytesPerFrame;
+    return true;
+}
@@ -0,0 +1,484 @@
+#include <math.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "convolution_reverb_module.h"
+#include "audio_module.h"
+#include "resampler.h"
+#include "wav_file.h"
+
+/*
+ * Two-stage partitioned convolution. The head of the impulse response is
+ * convolved in the audio thread with partitions of one block. Everything
+ * after the first 2*T samples is convolved by a worker thread with
+ * partitions of T = CONV_TAIL_RATIO blocks; the head covers that span, so
+ * the worker has a full tail block of time to deliver each result. The
+ * audio thread never waits for it: a result that is not ready in time is
+ * counted as an overrun and its tail block stays silent.
+ */
+
+static PartitionedConvolver* create_convolver(const float *ir, int irLength, int blockSize);
+static void destroy_convolver(PartitionedConvolver *pc);
+static void reset_convolver(PartitionedConvolver *pc);
+static void run_convolver(PartitionedConvolver *pc, const float *input, float *output);
+static bool build_engine(ConvolutionReverb *reverb);
+static void teardown_engine(ConvolutionReverb *reverb);
+static void process_block(ConvolutionReverb *reverb);
+static void post_tail_job(ConvolutionReverb *reverb);
+static void* tail_worker(void *args);
+
+static void* create(void) {
+    ConvolutionReverb* reverb = (ConvolutionReverb*)calloc(1, sizeof(ConvolutionReverb));
+    if (!reverb) {
+        fprintf(stderr, "Failed to allocate convolution reverb\n");
+        return NULL;
+    }
+    reverb->wet = 1.0f;
+    reverb->dry = 0.0f;
+    sem_init(&reverb->jobReady, 0, 0);
+    atomic_init(&reverb->quit, false);
+    atomic_init(&reverb->jobsPosted, 0);
+    atomic_init(&reverb->jobsDone, 0);
+    atomic_init(&reverb->overruns, 0);
+    return reverb;
+}
+
+static void destroy(void* instance) {
+    ConvolutionReverb* reverb = (ConvolutionReverb*)instance;
+    teardown_engine(reverb);
+    sem_destroy(&reverb->jobReady);
+    free(reverb->ir);
+    free(reverb);
+}
+
+static void init(void* instance, int sampleRate, int bufferSize) {
+    ConvolutionReverb* reverb = (ConvolutionReverb*)instance;
+    reverb->sampleRate = sampleRate;
+
+    int blockSize = 1;
+    while (blockSize < bufferSize) {blockSize <<= 1;}
+
+    teardown_engine(reverb);
+    reverb->blockSize = blockSize;
+    build_engine(reverb);
+}
+
+static void process(void* instance, const float* input, float* output, int numSamples) {
+    ConvolutionReverb* reverb = (ConvolutionReverb*)instance;
+
+    if (!reverb->inputFifo) {
+        memset(output, 0, numSamples * sizeof(float));
+        return;
+    }
+
+    for (int i = 0; i < numSamples; i++) {
+        reverb->inputFifo[reverb->fifoPos] = input[i];
+        output[i] = reverb->outputFifo[reverb->fifoPos];
+
+        if (++reverb->fifoPos == reverb->blockSize) {
+            process_block(reverb);
+            reverb->fifoPos = 0;
+        }
+    }
+}
+
+static void setParameter(void* instance, int parameterId, float value) {
+    ConvolutionReverb* reverb = (ConvolutionReverb*)instance;
+    switch (parameterId) {
+        case CONV_WET_PARAM:
+            reverb->wet = fmax(0.0f, fmin(value, 1.0f));
+            break;
+        case CONV_DRY_PARAM:
+            reverb->dry = fmax(0.0f, fmin(value, 1.0f));
+            break;
+    }
+}
+
+static float getParameter(void* instance, int parameterId) {
+    ConvolutionReverb* reverb = (ConvolutionReverb*)instance;
+    switch (parameterId) {
+        case CONV_WET_PARAM: return reverb->wet;
+        case CONV_DRY_PARAM: return reverb->dry;
+        default: return 0.0f;
+    }
+}
+
+static void reset(void* instance) {
+    ConvolutionReverb* reverb = (ConvolutionReverb*)instance;
+
+    // not realtime safe: the worker must be done with the tail before it is cleared
+    while (atomic_load_explicit(&reverb->jobsDone, memory_order_acquire) !=
+           atomic_load_explicit(&reverb->jobsPosted, memory_order_relaxed)) {
+        sched_yield();
+    }
+    reverb->dropLateResult = false;
+
+    reset_convolver(reverb->head);
+    reset_convolver(reverb->tail);
+    reverb->fifoPos = 0;
+    reverb->tailPos = 0;
+
+    if (reverb->inputFifo) {
+        memset(reverb->inputFifo, 0, reverb->blockSize * sizeof(float));
+        memset(reverb->outputFifo, 0, reverb->blockSize * sizeof(float));
+    }
+    if (reverb->tail) {
+        memset(reverb->tailInput, 0, reverb->tailBlockSize * sizeof(float));
+        memset(reverb->tailOutput, 0, reverb->tailBlockSize * sizeof(float));
+        memset(reverb->jobOutput, 0, reverb->tailBlockSize * sizeof(float));
+    }
+}
+
+static int getLatency(void* instance) {
+    ConvolutionReverb* reverb = (ConvolutionReverb*)instance;
+    return reverb->blockSize;
+}
+
+// each sample goes into the input FIFO before its output slot is written
+static void processInPlace(void* instance, float* buffer, int numSamples) {
+    process(instance, buffer, buffer, numSamples);
+}
+
+AudioModuleInterface ConvolutionReverbModule = {
+    .create = create,
+    .destroy = destroy,
+    .init = init,
+    .process = process,
+    .setParameter = setParameter,
+    .getParameter = getParameter,
+    .reset = reset,
+    .getLatency = getLatency,
+    .processInPlace = processInPlace,
+};
+
+bool convolution_reverb_load_ir(ConvolutionReverb *reverb, const char *path) {
+    if (!reverb || !path) {return false;}
+
+    int length = 0;
+    int sampleRate = 0;
+    float *ir = load_wav_mono(path, &length, &sampleRate);
+    if (!ir) {return false;}
+
+    const bool ok = convolution_reverb_set_ir(reverb, ir, length, sampleRate);
+    free(ir);
+    return ok;
+}
+
+bool convolution_reverb_set_ir(ConvolutionReverb *reverb, const float *ir, int length, int sampleRate) {
+    if (!reverb || !ir || length <= 0) {return false;}
+
+    float *copy = (float*)malloc(length * sizeof(float));
+    if (!copy) {
+        fprintf(stderr, "Failed to allocate impulse response\n");
+        return false;
+    }
+    memcpy(copy, ir, length * sizeof(float));
+
+    teardown_engine(reverb);
+    free(reverb->ir);
+    reverb->ir = copy;
+    reverb->irLength = length;
+    reverb->irSampleRate = sampleRate;
+
+    if (reverb->blockSize > 0) {
+        return build_engine(reverb);
+    }
+    return true;
+}
+
+void convolution_reverb_set_offline(ConvolutionReverb *reverb, bool offline) {
+    if (!reverb) {return;}
+    reverb->offline = offline;
+}
+
+static bool build_engine(ConvolutionReverb *reverb) {
+    const int blockSize = reverb->blockSize;
+
+    reverb->inputFifo = (float*)calloc(blockSize, sizeof(float));
+    reverb->outputFifo = (float*)calloc(blockSize, sizeof(float));
+    reverb->headOutput = (float*)calloc(blockSize, sizeof(float));
+    reverb->fifoPos = 0;
+    if (!reverb->inputFifo || !reverb->outputFifo || !reverb->headOutput) {
+        fprintf(stderr, "Failed to allocate convolution buffers\n");
+        teardown_engine(reverb);
+        return false;
+    }
+
+    if (!reverb->ir) {return true;}
+
+    const float *ir = reverb->ir;
+    int irLength = reverb->irLength;
+    float *converted = NULL;
+    if (reverb->irSampleRate > 0 && reverb->irSampleRate != reverb->sampleRate) {
+        converted = resample_buffer(reverb->ir, reverb->irLength, reverb->irSampleRate, reverb->sampleRate, &irLength);
+        if (!converted) {
+            teardown_engine(reverb);
+            return false;
+        }
+        // resampling keeps sample values, so the sum of the taps follows the rate ratio; undo that
+        const float gain = (float)reverb->irSampleRate / reverb->sampleRate;
+        for (int i = 0; i < irLength; i++) {
+            converted[i] *= gain;
+        }
+        ir = converted;
+    }
+
+    const int tailBlockSize = blockSize * CONV_TAIL_RATIO;
+    const int headLength = (irLength < 2 * tailBlockSize) ? irLength : 2 * tailBlockSize;
+
+    reverb->head = create_convolver(ir, headLength, blockSize);
+    if (!reverb->head) {
+        free(converted);
+        teardown_engine(reverb);
+        return false;
+    }
+
+    if (irLength <= headLength) {
+        free(converted);
+        return true;
+    }
+
+    reverb->tailBlockSize = tailBlockSize;
+    reverb->tailPos = 0;
+    reverb->tail = create_convolver(ir + headLength, irLength - headLength, tailBlockSize);
+    free(converted);
+    reverb->tailInput = (float*)calloc(tailBlockSize, sizeof(float));
+    reverb->tailOutput = (float*)calloc(tailBlockSize, sizeof(float));
+    reverb->jobInput = (float*)calloc(tailBlockSize, sizeof(float));
+    reverb->jobOutput = (float*)calloc(tailBlockSize, sizeof(float));
+    if (!reverb->tail || !reverb->tailInput || !reverb->tailOutput ||
+        !reverb->jobInput || !reverb->jobOutput) {
+        fprintf(stderr, "Failed to allocate convolution tail\n");
+        teardown_engine(reverb);
+        return false;
+    }
+
+    atomic_store_explicit(&reverb->quit, false, memory_order_relaxed);
+    atomic_store_explicit(&reverb->jobsPosted, 0, memory_order_relaxed);
+    atomic_store_explicit(&reverb->jobsDone, 0, memory_order_relaxed);
+    reverb->dropLateResult = false;
+    // wake-ups left over from a previous worker
+    while (sem_trywait(&reverb->jobReady) == 0) {}
+    if (pthread_create(&reverb->worker, NULL, tail_worker, reverb) != 0) {
+        fprintf(stderr, "Failed to start convolution worker\n");
+        teardown_engine(reverb);
+        return false;
+    }
+    reverb->workerRunning = true;
+    return true;
+}
+
+static void teardown_engine(ConvolutionReverb *reverb) {
+    if (reverb->workerRunning) {
+        atomic_store_explicit(&reverb->quit, true, memory_order_release);
+        sem_post(&reverb->jobReady);
+        pthread_join(reverb->worker, NULL);
+        reverb->workerRunning = false;
+    }
+
+    destroy_convolver(reverb->head);
+    destroy_convolver(reverb->tail);
+    reverb->head = NULL;
+    reverb->tail = NULL;
+
+    free(reverb->inputFifo);
+    free(reverb->outputFifo);
+    free(reverb->headOutput);
+    free(reverb->tailInput);
+    free(reverb->tailOutput);
+    free(reverb->jobInput);
+    free(reverb->jobOutput);
+    reverb->inputFifo = reverb->outputFifo = reverb->headOutput = NULL;
+    reverb->tailInput = reverb->tailOutput = NULL;
+    reverb->jobInput = reverb->jobOutput = NULL;
+}
+
+static void process_block(ConvolutionReverb *reverb) {
+    const int blockSize = reverb->blockSize;
+    const float *input = reverb->inputFifo;
+    float *wetBuffer = reverb->headOutput;
+
+    if (reverb->head) {
+        run_convolver(reverb->head, input, wetBuffer);
+    } else {
+        memset(wetBuffer, 0, blockSize * sizeof(float));
+    }
+
+    if (reverb->tail) {
+        const float *tailOutput = reverb->tailOutput + reverb->tailPos;
+        for (int i = 0; i < blockSize; i++) {
+            wetBuffer[i] += tailOutput[i];
+        }
+        memcpy(reverb->tailInput + reverb->tailPos, input, blockSize * sizeof(float));
+        reverb->tailPos += blockSize;
+
+        if (reverb->tailPos == reverb->tailBlockSize) {
+            reverb->tailPos = 0;
+            post_tail_job(reverb);
+        }
+    }
+
+    const float wet = reverb->wet;
+    const float dry = reverb->dry;
+    for (int i = 0; i < blockSize; i++) {
+        reverb->outputFifo[i] = dry * input[i] + wet * wetBuffer[i];
+    }
+}
+
+/*
+ * Called when a tail block of input is complete. The previous job's
+ * result is due now; if the worker has it, it becomes the tail output for
+ * the coming period and the new block is handed over. Otherwise this
+ * block is dropped and both the coming period and the period the late
+ * result was meant for play without the tail.
+ */
+static void post_tail_job(ConvolutionReverb *reverb) {
+    const unsigned posted = atomic_load_explicit(&reverb->jobsPosted, memory_order_relaxed);
+    if (atomic_load_explicit(&reverb->jobsDone, memory_order_acquire) != posted) {
+        memset(reverb->tailOutput, 0, reverb->tailBlockSize * sizeof(float));
+        reverb->dropLateResult = true;
+        atomic_fetch_add_explicit(&reverb->overruns, 1, memory_order_relaxed);
+        return;
+    }
+
+    float *swap = reverb->tailOutput;
+    reverb->tailOutput = reverb->jobOutput;
+    reverb->jobOutput = swap;
+    if (reverb->dropLateResult) {
+        memset(reverb->tailOutput, 0, reverb->tailBlockSize * sizeof(float));
+        reverb->dropLateResult = false;
+    }
+
+    swap = reverb->jobInput;
+    reverb->jobInput = reverb->tailInput;
+    reverb->tailInput = swap;
+
+    if (reverb->offline) {
+        run_convolver(reverb->tail, reverb->jobInput, reverb->jobOutput);
+        atomic_store_explicit(&reverb->jobsPosted, posted + 1, memory_order_relaxed);
+        atomic_store_explicit(&reverb->jobsDone, posted + 1, memory_order_relaxed);
+        return;
+    }
+    atomic_store_explicit(&reverb->jobsPosted, posted + 1, memory_order_release);
+    sem_post(&reverb->jobReady);
+}
+
+static void* tail_worker(void *args) {
+    ConvolutionReverb* reverb = (ConvolutionReverb*)args;
+
+    for (;;) {
+        // retried when a signal interrupts the wait
+        if (sem_wait(&reverb->jobReady) != 0) {continue;}
+        if (atomic_load_explicit(&reverb->quit, memory_order_acquire)) {break;}
+
+        const unsigned job = atomic_load_explicit(&reverb->jobsPosted, memory_order_acquire);
+        if (job == atomic_load_explicit(&reverb->jobsDone, memory_order_relaxed)) {continue;}
+
+        run_convolver(reverb->tail, reverb->jobInput, reverb->jobOutput);
+        atomic_store_explicit(&reverb->jobsDone, job, memory_order_release);
+    }
+    return NULL;
+}
+
+static PartitionedConvolver* create_convolver(const float *ir, int irLength, int blockSize) {
+    PartitionedConvolver *pc = (PartitionedConvolver*)calloc(1, sizeof(PartitionedConvolver));
+    if (!pc) {
+        fprintf(stderr, "Failed to allocate convolver\n");
+        return NULL;
+    }
+    pc->blockSize = blockSize;
+    pc->numBins = blockSize + 1;
+    pc->numPartitions = (irLength + blockSize - 1) / blockSize;
+    if (pc->numPartitions < 1) {pc->numPartitions = 1;}
+
+    const size_t spectrumSize = (size_t)pc->numPartitions * pc->numBins;
+    pc->fft = create_real_fft(2 * blockSize);
+    pc->irRe = (float*)calloc(spectrumSize, sizeof(float));
+    pc->irIm = (float*)calloc(spectrumSize, sizeof(float));
+    pc->fdlRe = (float*)calloc(spectrumSize, sizeof(float));
+    pc->fdlIm = (float*)calloc(spectrumSize, sizeof(float));
+    pc->accRe = (float*)calloc(pc->numBins, sizeof(float));
+    pc->accIm = (float*)calloc(pc->numBins, sizeof(float));
+    pc->timeBuffer = (float*)calloc(2 * blockSize, sizeof(float));
+    pc->outputBuffer = (float*)calloc(2 * blockSize, sizeof(float));
+
+    if (!pc->fft || !pc->irRe || !pc->irIm || !pc->fdlRe || !pc->fdlIm ||
+        !pc->accRe || !pc->accIm || !pc->timeBuffer || !pc->outputBuffer) {
+        fprintf(stderr, "Failed to allocate convolver buffers\n");
+        destroy_convolver(pc);
+        return NULL;
+    }
+
+    // each partition is zero padded to twice its length for overlap-save
+    for (int p = 0; p < pc->numPartitions; p++) {
+        const int offset = p * blockSize;
+        const int count = (irLength - offset < blockSize) ? irLength - offset : blockSize;
+
+        memset(pc->timeBuffer, 0, 2 * blockSize * sizeof(float));
+        memcpy(pc->timeBuffer, ir + offset, count * sizeof(float));
+        real_fft_forward(pc->fft, pc->timeBuffer,
+                         pc->irRe + (size_t)p * pc->numBins,
+                         pc->irIm + (size_t)p * pc->numBins);
+    }
+    memset(pc->timeBuffer, 0, 2 * blockSize * sizeof(float));
+    return pc;
+}
+
+static void destroy_convolver(PartitionedConvolver *pc) {
+    if (!pc) {return;}
+
+    destroy_real_fft(pc->fft);
+    free(pc->irRe);
+    free(pc->irIm);
+    free(pc->fdlRe);
+    free(pc->fdlIm);
+    free(pc->accRe);
+    free(pc->accIm);
+    free(pc->timeBuffer);
+    free(pc->outputBuffer);
+    free(pc);
+}
+
+static void reset_convolver(PartitionedConvolver *pc) {
+    if (!pc) {return;}
+
+    const size_t spectrumSize = (size_t)pc->numPartitions * pc->numBins;
+    memset(pc->fdlRe, 0, spectrumSize * sizeof(float));
+    memset(pc->fdlIm, 0, spectrumSize * sizeof(float));
+    memset(pc->timeBuffer, 0, 2 * pc->blockSize * sizeof(float));
+    pc->fdlPos = 0;
+}
+
+static void run_convolver(PartitionedConvolver *pc, const float *input, float *output) {
+    const int blockSize = pc->blockSize;
+    const int numBins = pc->numBins;
+
+    memmove(pc->timeBuffer, pc->timeBuffer + blockSize, blockSize * sizeof(float));
+    memcpy(pc->timeBuffer + blockSize, input, blockSize * sizeof(float));
+
+    real_fft_forward(pc->fft, pc->timeBuffer,
+                     pc->fdlRe + (size_t)pc->fdlPos * numBins,
+                     pc->fdlIm + (size_t)pc->fdlPos * numBins);
+
+    memset(pc->accRe, 0, numBins * sizeof(float));
+    memset(pc->accIm, 0, numBins * sizeof(float));
+
+    // frequency-domain delay line: spectrum of block m-p meets partition p
+    for (int p = 0; p < pc->numPartitions; p++) {
+        int slot = pc->fdlPos - p;
+        if (slot < 0) {slot += pc->numPartitions;}
+
+        complex_multiply_accumulate(pc->accRe, pc->accIm,
+                                    pc->fdlRe + (size_t)slot * numBins,
+                                    pc->fdlIm + (size_t)slot * numBins,
+                                    pc->irRe + (size_t)p * numBins,
+                                    pc->irIm + (size_t)p * numBins,
+                                    numBins);
+    }
+
+    real_fft_inverse(pc->fft, pc->accRe, pc->accIm, pc->outputBuffer);
+    memcpy(output, pc->outputBuffer + blockSize, blockSize * sizeof(float));
+
+    if (++pc->fdlPos == pc->numPartitions) {pc->fdlPos = 0;}
+}
@@ -88,6 +88,11 @@ static void reset(void* instance) {
     filter->y1 = filter->y2 = 0.0f;
 }
 
+// the biquad reads x[i] before storing y[i], so input and output may alias
+static void processInPlace(void* instance, float* buffer, int numSamples) {
+    process(instance, buffer, buffer, numSamples);
+}
+
 AudioModuleInterface LowPassFilterModule = {
     .create = create,
     .destroy = destroy,
@@ -95,7 +100,8 @@ AudioModuleInterface LowPassFilterModule = {
     .process = process,
     .setParameter = setParameter,
     .getParameter = getParameter,
-    .reset = reset
+    .reset = reset,
+    .processInPlace = processInPlace
 };
 
 static void compute_coefficients(LowPassFilter * filter) {
@@ -8,13 +8,25 @@ static void* create(void){
     return node;
 }
 
+static void free_outputs(OutputNode* node) {
+    if (!node->outputs) {return;}
+
+    for(int c = 0; c < node->channelCount; c++) {
+        free(node->outputs[c]);
+    }
+    free(node->outputs);
+    node->outputs = NULL;
+}
+
 static void destroy(void* instance) {
     OutputNode* node = (OutputNode*)instance;
+    free_outputs(node);
     free(node);
 }
 
 static void init(void* instance, int sampleRate, int bufferSize) {
     OutputNode* node = (OutputNode*)instance;
+    free_outputs(node);
     node->outputs = calloc(node->channelCount, sizeof(float*));
     for(int c = 0; c < node->channelCount; c++) {
         node->outputs[c] = malloc(bufferSize * sizeof(float));
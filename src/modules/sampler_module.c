@@ -0,0 +1,418 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include "sampler_module.h"
+#include "audio_module.h"
+
+/*
+ * The sample file is memory mapped and never copied into the heap. The
+ * first SAMPLER_PRELOAD_FRAMES are faulted in at load time; after that a
+ * streaming thread faults pages in ahead of the playhead and drops pages
+ * it has passed. It publishes how far the data is resident, tagged with
+ * the playback generation, and the audio thread never reads beyond that,
+ * so it outputs silence on an underrun instead of blocking on the disk.
+ *
+ * One streaming thread serves every sampler whose file is longer than the
+ * preload. It runs while the first of them is loaded, services the playing
+ * ones every STREAMER_PERIOD_NS and sleeps on a semaphore while none is
+ * playing; a trigger posts the semaphore, which is safe from the audio
+ * thread.
+ *
+ * A file at another rate than the engine is pulled through a streaming
+ * resampler: each block reads exactly the frames the resampler needs, and
+ * after the last frame of a one-shot the filter is flushed with silence.
+ */
+
+#define STREAMER_PERIOD_NS 5000000L
+
+static struct {
+    // held across start and stop, so a new thread never races a joining one
+    pthread_mutex_t lifecycle;
+    // guards the list; held while a sampler is serviced
+    pthread_mutex_t lock;
+    Sampler **samplers;
+    int numSamplers;
+    pthread_t thread;
+    sem_t wake;
+    bool running;
+    bool quit;
+} streamer = {
+    .lifecycle = PTHREAD_MUTEX_INITIALIZER,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static bool register_sampler(Sampler *sampler);
+static void unregister_sampler(Sampler *sampler);
+static void* stream_thread(void *args);
+static void restart_playback(Sampler *sampler, int position);
+static void setup_resampler(Sampler *sampler);
+static void teardown_resampler(Sampler *sampler);
+static void read_frames(Sampler *sampler, float *output, int numFrames);
+
+static void* create(void) {
+    Sampler* sampler = (Sampler*)calloc(1, sizeof(Sampler));
+    if (!sampler) {
+        fprintf(stderr, "Failed to allocate sampler\n");
+        return NULL;
+    }
+    sampler->gain = 1.0f;
+    atomic_init(&sampler->triggerPending, false);
+    atomic_init(&sampler->playhead, 0);
+    atomic_init(&sampler->generation, 0);
+    atomic_init(&sampler->ready, 0);
+    atomic_init(&sampler->underruns, 0);
+    atomic_init(&sampler->streaming, false);
+    return sampler;
+}
+
+static void destroy(void* instance) {
+    Sampler* sampler = (Sampler*)instance;
+    unregister_sampler(sampler);
+    teardown_resampler(sampler);
+    close_mapped_sample(sampler->sample);
+    free(sampler);
+}
+
+static void init(void* instance, int sampleRate, int bufferSize) {
+    Sampler* sampler = (Sampler*)instance;
+    sampler->sampleRate = sampleRate;
+    sampler->bufferSize = bufferSize;
+    setup_resampler(sampler);
+}
+
+static void process(void* instance, const float* input, float* output, int numSamples) {
+    Sampler* sampler = (Sampler*)instance;
+    (void)input;
+
+    if (atomic_exchange_explicit(&sampler->triggerPending, false, memory_order_acquire)) {
+        restart_playback(sampler, 0);
+        sampler->playing = sampler->sample != NULL;
+        if (sampler->resampler) {reset_resampler(sampler->resampler);}
+        if (sampler->registered && sampler->playing) {
+            atomic_store_explicit(&sampler->streaming, true, memory_order_release);
+            sem_post(&streamer.wake);
+        }
+    }
+
+    if (!sampler->playing) {
+        memset(output, 0, numSamples * sizeof(float));
+        return;
+    }
+
+    if (!sampler->resampler) {
+        read_frames(sampler, output, numSamples);
+        return;
+    }
+
+    // pull in pieces of at most one block so the input always fits resampleInput
+    for (int i = 0; i < numSamples; i += sampler->bufferSize) {
+        const int count = (numSamples - i < sampler->bufferSize) ? numSamples - i : sampler->bufferSize;
+        const int needed = resampler_input_needed(sampler->resampler, count);
+        read_frames(sampler, sampler->resampleInput, needed);
+        resampler_process(sampler->resampler, sampler->resampleInput, needed, output + i, count);
+    }
+}
+
+static void setParameter(void* instance, int parameterId, float value) {
+    Sampler* sampler = (Sampler*)instance;
+    switch (parameterId) {
+        case SAMPLER_GAIN_PARAM:
+            sampler->gain = value;
+            break;
+        case SAMPLER_LOOP_PARAM:
+            sampler->loop = value >= 0.5f;
+            break;
+        case SAMPLER_TRIGGER_PARAM:
+            if (value > 0.0f) {
+                atomic_store_explicit(&sampler->triggerPending, true, memory_order_release);
+            }
+            break;
+    }
+}
+
+static float getParameter(void* instance, int parameterId) {
+    Sampler* sampler = (Sampler*)instance;
+    switch (parameterId) {
+        case SAMPLER_GAIN_PARAM: return sampler->gain;
+        case SAMPLER_LOOP_PARAM: return sampler->loop ? 1.0f : 0.0f;
+        case SAMPLER_TRIGGER_PARAM: return sampler->playing ? 1.0f : 0.0f;
+        default: return 0.0f;
+    }
+}
+
+static void reset(void* instance) {
+    Sampler* sampler = (Sampler*)instance;
+    atomic_store_explicit(&sampler->triggerPending, false, memory_order_relaxed);
+    restart_playback(sampler, 0);
+    sampler->playing = false;
+    atomic_store_explicit(&sampler->streaming, false, memory_order_relaxed);
+    if (sampler->resampler) {reset_resampler(sampler->resampler);}
+}
+
+// playback ignores the input, so the buffer is simply overwritten
+static void processInPlace(void* instance, float* buffer, int numSamples) {
+    process(instance, buffer, buffer, numSamples);
+}
+
+AudioModuleInterface SamplerModule = {
+    .create = create,
+    .destroy = destroy,
+    .init = init,
+    .process = process,
+    .setParameter = setParameter,
+    .getParameter = getParameter,
+    .reset = reset,
+    .processInPlace = processInPlace
+};
+
+bool sampler_load(Sampler *sampler, const char *path) {
+    if (!sampler || !path) {return false;}
+
+    MappedSample *sample = open_mapped_sample(path);
+    if (!sample) {return false;}
+
+    unregister_sampler(sampler);
+    close_mapped_sample(sampler->sample);
+    sampler->sample = sample;
+    sampler->playing = false;
+    atomic_store_explicit(&sampler->streaming, false, memory_order_relaxed);
+    if (sampler->sampleRate > 0) {setup_resampler(sampler);}
+
+    sampler->preloadFrames = sample->info.numFrames < SAMPLER_PRELOAD_FRAMES ?
+                             sample->info.numFrames : SAMPLER_PRELOAD_FRAMES;
+    mapped_sample_prefetch(sample, 0, sampler->preloadFrames);
+    restart_playback(sampler, 0);
+
+    if (sample->info.numFrames <= sampler->preloadFrames) {return true;}
+    return register_sampler(sampler);
+}
+
+// reads numFrames frames at the playhead, scaled by the gain, and advances it
+static void read_frames(Sampler *sampler, float *output, int numFrames) {
+    const MappedSample *sample = sampler->sample;
+    const int fileFrames = sample->info.numFrames;
+    // a one-shot plays on past the file until the resampler has emptied
+    const int endFrames = fileFrames + (sampler->resampler ? sampler->resampler->numTaps : 0);
+    const float gain = sampler->gain;
+
+    unsigned generation = atomic_load_explicit(&sampler->generation, memory_order_relaxed);
+    const uint_least64_t ready = atomic_load_explicit(&sampler->ready, memory_order_acquire);
+    int residentUntil = sampler->preloadFrames;
+    if ((unsigned)(ready >> 32) == generation && (int)(ready & 0xffffffff) > residentUntil) {
+        residentUntil = (int)(ready & 0xffffffff);
+    }
+
+    int i = 0;
+    while (i < numFrames) {
+        if (sampler->position >= fileFrames) {
+            if (sampler->loop) {
+                restart_playback(sampler, 0);
+                generation++;
+                residentUntil = sampler->preloadFrames;
+            } else if (sampler->position >= endFrames) {
+                sampler->playing = false;
+                atomic_store_explicit(&sampler->streaming, false, memory_order_relaxed);
+                memset(output + i, 0, (numFrames - i) * sizeof(float));
+                break;
+            } else {
+                const int count = (numFrames - i < endFrames - sampler->position) ?
+                                  numFrames - i : endFrames - sampler->position;
+                memset(output + i, 0, count * sizeof(float));
+                sampler->position += count;
+                i += count;
+                continue;
+            }
+        }
+
+        const int position = sampler->position;
+        const int count = (numFrames - i < fileFrames - position) ? numFrames - i : fileFrames - position;
+        int readable = residentUntil - position;
+        if (readable < 0) {readable = 0;}
+        if (readable > count) {readable = count;}
+
+        if (sample->direct) {
+            // zero copy: scale straight out of the mapping
+            const float *src = sample->direct + position;
+            for (int k = 0; k < readable; k++) {
+                output[i + k] = src[k] * gain;
+            }
+        } else if (readable > 0) {
+            mapped_sample_read(sample, position, readable, output + i);
+            for (int k = 0; k < readable; k++) {
+                output[i + k] *= gain;
+            }
+        }
+
+        if (readable < count) {
+            memset(output + i + readable, 0, (count - readable) * sizeof(float));
+            atomic_fetch_add_explicit(&sampler->underruns, 1, memory_order_relaxed);
+        }
+
+        sampler->position += count;
+        i += count;
+    }
+
+    atomic_store_explicit(&sampler->playhead, sampler->position, memory_order_release);
+}
+
+static void setup_resampler(Sampler *sampler) {
+    teardown_resampler(sampler);
+    if (!sampler->sample || sampler->sample->info.sampleRate == sampler->sampleRate) {return;}
+
+    const int fileRate = sampler->sample->info.sampleRate;
+    sampler->resampler = create_resampler(fileRate, sampler->sampleRate);
+    // a pull of one block needs at most its length at the file rate plus two frames
+    const int inputSize = (int)(((long long)sampler->bufferSize * fileRate + sampler->sampleRate - 1) /
+                                sampler->sampleRate) + 2;
+    sampler->resampleInput = (float*)calloc(inputSize, sizeof(float));
+    if (!sampler->resampler || !sampler->resampleInput) {
+        fprintf(stderr, "Failed to resample %d Hz sample to %d Hz, playing it unconverted\n",
+                fileRate, sampler->sampleRate);
+        teardown_resampler(sampler);
+    }
+}
+
+static void teardown_resampler(Sampler *sampler) {
+    destroy_resampler(sampler->resampler);
+    free(sampler->resampleInput);
+    sampler->resampler = NULL;
+    sampler->resampleInput = NULL;
+}
+
+static void restart_playback(Sampler *sampler, int position) {
+    sampler->position = position;
+    atomic_store_explicit(&sampler->playhead, position, memory_order_release);
+    atomic_fetch_add_explicit(&sampler->generation, 1, memory_order_release);
+}
+
+static bool register_sampler(Sampler *sampler) {
+    pthread_mutex_lock(&streamer.lifecycle);
+    if (!streamer.running) {
+        sem_init(&streamer.wake, 0, 0);
+        streamer.quit = false;
+        if (pthread_create(&streamer.thread, NULL, stream_thread, NULL) != 0) {
+            fprintf(stderr, "Failed to start sample streaming thread\n");
+            sem_destroy(&streamer.wake);
+            pthread_mutex_unlock(&streamer.lifecycle);
+            return false;
+        }
+        streamer.running = true;
+    }
+
+    pthread_mutex_lock(&streamer.lock);
+    Sampler **samplers = (Sampler**)realloc(streamer.samplers, (streamer.numSamplers + 1) * sizeof(Sampler*));
+    if (samplers) {
+        streamer.samplers = samplers;
+        streamer.samplers[streamer.numSamplers++] = sampler;
+        // the first service treats the current generation as a jump
+        sampler->streamGeneration = atomic_load_explicit(&sampler->generation, memory_order_relaxed) - 1;
+        sampler->residentUntil = sampler->preloadFrames;
+        sampler->releasedUntil = sampler->preloadFrames;
+        sampler->registered = true;
+    }
+    pthread_mutex_unlock(&streamer.lock);
+    pthread_mutex_unlock(&streamer.lifecycle);
+
+    if (!samplers) {fprintf(stderr, "Failed to register sampler for streaming\n");}
+    return samplers != NULL;
+}
+
+// returns once the streaming thread is done with the sampler, stopping it after the last one
+static void unregister_sampler(Sampler *sampler) {
+    if (!sampler->registered) {return;}
+
+    pthread_mutex_lock(&streamer.lifecycle);
+    pthread_mutex_lock(&streamer.lock);
+    for (int i = 0; i < streamer.numSamplers; i++) {
+        if (streamer.samplers[i] == sampler) {
+            streamer.samplers[i] = streamer.samplers[--streamer.numSamplers];
+            break;
+        }
+    }
+    sampler->registered = false;
+    const bool last = streamer.numSamplers == 0;
+    if (last) {streamer.quit = true;}
+    pthread_mutex_unlock(&streamer.lock);
+
+    if (last) {
+        sem_post(&streamer.wake);
+        pthread_join(streamer.thread, NULL);
+        sem_destroy(&streamer.wake);
+        free(streamer.samplers);
+        streamer.samplers = NULL;
+        streamer.running = false;
+    }
+    pthread_mutex_unlock(&streamer.lifecycle);
+}
+
+// faults in the window ahead of the playhead and drops what it has passed
+static void stream_sampler(Sampler *sampler) {
+    MappedSample *sample = sampler->sample;
+    const int numFrames = sample->info.numFrames;
+    const int preloadFrames = sampler->preloadFrames;
+
+    const unsigned current = atomic_load_explicit(&sampler->generation, memory_order_acquire);
+    const int playhead = atomic_load_explicit(&sampler->playhead, memory_order_acquire);
+
+    if (current != sampler->streamGeneration) {
+        // playback jumped; everything past the preloaded head may be gone
+        sampler->streamGeneration = current;
+        sampler->residentUntil = playhead > preloadFrames ? playhead : preloadFrames;
+        sampler->releasedUntil = preloadFrames;
+    }
+
+    int target = playhead + SAMPLER_STREAM_AHEAD_FRAMES;
+    if (target > numFrames) {target = numFrames;}
+    if (target > sampler->residentUntil) {
+        mapped_sample_prefetch(sample, sampler->residentUntil, target - sampler->residentUntil);
+        sampler->residentUntil = target;
+    }
+    atomic_store_explicit(&sampler->ready,
+                          ((uint_least64_t)sampler->streamGeneration << 32) | (uint_least64_t)sampler->residentUntil,
+                          memory_order_release);
+
+    const int releaseEnd = playhead - SAMPLER_STREAM_AHEAD_FRAMES;
+    if (releaseEnd > sampler->releasedUntil) {
+        mapped_sample_release(sample, sampler->releasedUntil, releaseEnd - sampler->releasedUntil);
+        sampler->releasedUntil = releaseEnd;
+    }
+}
+
+static void* stream_thread(void *args) {
+    (void)args;
+
+    pthread_mutex_lock(&streamer.lock);
+    while (!streamer.quit) {
+        bool active = false;
+        for (int i = 0; i < streamer.numSamplers; i++) {
+            Sampler *sampler = streamer.samplers[i];
+            if (atomic_load_explicit(&sampler->streaming, memory_order_acquire)) {
+                stream_sampler(sampler);
+                active = true;
+            }
+        }
+        pthread_mutex_unlock(&streamer.lock);
+
+        if (active) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += STREAMER_PERIOD_NS;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_nsec -= 1000000000L;
+                deadline.tv_sec++;
+            }
+            sem_timedwait(&streamer.wake, &deadline);
+        } else {
+            // idle until a trigger or unregister_sampler posts
+            sem_wait(&streamer.wake);
+        }
+
+        pthread_mutex_lock(&streamer.lock);
+    }
+    pthread_mutex_unlock(&streamer.lock);
+    return NULL;
+}
@@ -67,6 +67,11 @@ static void reset(void* instance) {
     osc->phase = 0.0f;
 }
 
+// a generator: whatever is in the buffer gets replaced
+static void processInPlace(void* instance, float* buffer, int numSamples) {
+    process(instance, buffer, buffer, numSamples);
+}
+
 AudioModuleInterface SineOscillatorModule = {
     .create = create,
     .destroy = destroy,
@@ -74,5 +79,6 @@ AudioModuleInterface SineOscillatorModule = {
     .process = process,
     .setParameter = setParameter,
     .getParameter = getParameter,
-    .reset = reset
+    .reset = reset,
+    .processInPlace = processInPlace
 };
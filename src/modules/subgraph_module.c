@@ -0,0 +1,197 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "subgraph_module.h"
+#include "output_module.h"
+
+static void teardown_rates(Subgraph *subgraph);
+
+/* INNER SOURCE, hands the resampled input to the inner graph */
+
+typedef struct {
+    const float *samples;
+} SubgraphSource;
+
+static void* create_source(void) {
+    return calloc(1, sizeof(SubgraphSource));
+}
+
+static void destroy_source(void* instance) {
+    free(instance);
+}
+
+static void process_source(void* instance, const float* input, float* output, int numSamples) {
+    SubgraphSource* source = (SubgraphSource*)instance;
+    (void)input;
+    if (source->samples) {
+        memcpy(output, source->samples, numSamples * sizeof(float));
+    } else {
+        memset(output, 0, numSamples * sizeof(float));
+    }
+}
+
+static AudioModuleInterface SubgraphSourceModule = {
+    .create = create_source,
+    .destroy = destroy_source,
+    .process = process_source,
+};
+
+/* SUBGRAPH */
+
+static void* create(void) {
+    Subgraph* subgraph = (Subgraph*)calloc(1, sizeof(Subgraph));
+    if (!subgraph) {
+        fprintf(stderr, "Failed to allocate subgraph\n");
+        return NULL;
+    }
+
+    subgraph->graph = create_audio_graph();
+    subgraph->input = subgraph->graph ? create_audio_node(&SubgraphSourceModule) : NULL;
+    if (!subgraph->input) {
+        destroy_audio_graph(subgraph->graph);
+        free(subgraph);
+        return NULL;
+    }
+    add_node(subgraph->graph, subgraph->input);
+    return subgraph;
+}
+
+static void destroy(void* instance) {
+    Subgraph* subgraph = (Subgraph*)instance;
+    teardown_rates(subgraph);
+    destroy_audio_graph(subgraph->graph);
+    free(subgraph);
+}
+
+static void init(void* instance, int sampleRate, int bufferSize) {
+    Subgraph* subgraph = (Subgraph*)instance;
+    const int internalRate = subgraph->internalRate > 0 ? subgraph->internalRate : sampleRate;
+
+    teardown_rates(subgraph);
+    subgraph->sampleRate = sampleRate;
+    subgraph->internalBufferSize = bufferSize;
+
+    if (internalRate != sampleRate) {
+        subgraph->internalBufferSize = (int)(((long long)bufferSize * internalRate + sampleRate - 1) / sampleRate) + 1;
+        subgraph->down = create_resampler(sampleRate, internalRate);
+        subgraph->up = create_resampler(internalRate, sampleRate);
+        // one block of resampled input plus what the last block left over
+        subgraph->inputFifo = (float*)calloc(subgraph->internalBufferSize + 2, sizeof(float));
+        if (!subgraph->down || !subgraph->up || !subgraph->inputFifo) {
+            fprintf(stderr, "Failed to set up subgraph at %d Hz, running it at %d Hz\n", internalRate, sampleRate);
+            teardown_rates(subgraph);
+            subgraph->internalBufferSize = bufferSize;
+        }
+    }
+
+    if (subgraph->output && subgraph->output->interface != &OutputNodeModule) {
+        fprintf(stderr, "Subgraph output must be an output node\n");
+        subgraph->output = NULL;
+    }
+    init_graph(subgraph->graph, subgraph->up ? internalRate : sampleRate, subgraph->internalBufferSize);
+}
+
+static void process(void* instance, const float* input, float* output, int numSamples) {
+    Subgraph* subgraph = (Subgraph*)instance;
+    SubgraphSource* source = (SubgraphSource*)subgraph->input->instance;
+
+    if (!subgraph->output) {
+        memset(output, 0, numSamples * sizeof(float));
+        return;
+    }
+    const float *innerOutput = ((OutputNode*)subgraph->output->instance)->outputs[0];
+
+    if (!subgraph->up) {
+        source->samples = input;
+        process_graph(subgraph->graph, numSamples);
+        memcpy(output, innerOutput, numSamples * sizeof(float));
+        return;
+    }
+
+    const bool usesInput = subgraph->input->numOutgoing > 0;
+    if (usesInput) {
+        subgraph->fifoFill += resampler_process(subgraph->down, input, numSamples,
+                                                subgraph->inputFifo + subgraph->fifoFill,
+                                                subgraph->internalBufferSize + 2 - subgraph->fifoFill);
+    }
+
+    // pull exactly as many inner samples as the upsampler needs for this block
+    const int needed = resampler_input_needed(subgraph->up, numSamples);
+    if (needed > 0) {
+        if (usesInput && subgraph->fifoFill < needed) {
+            memset(subgraph->inputFifo + subgraph->fifoFill, 0, (needed - subgraph->fifoFill) * sizeof(float));
+            subgraph->fifoFill = needed;
+        }
+
+        source->samples = usesInput ? subgraph->inputFifo : NULL;
+        process_graph(subgraph->graph, needed);
+
+        if (usesInput) {
+            subgraph->fifoFill -= needed;
+            memmove(subgraph->inputFifo, subgraph->inputFifo + needed, subgraph->fifoFill * sizeof(float));
+        }
+    }
+    resampler_process(subgraph->up, innerOutput, needed, output, numSamples);
+}
+
+static void reset(void* instance) {
+    Subgraph* subgraph = (Subgraph*)instance;
+
+    for (int i = 0; i < subgraph->graph->numNodes; i++) {
+        AudioNode *node = subgraph->graph->nodes[i];
+        if (node->interface->reset) {
+            node->interface->reset(node->instance);
+        }
+    }
+    if (subgraph->up) {
+        reset_resampler(subgraph->down);
+        reset_resampler(subgraph->up);
+        memset(subgraph->inputFifo, 0, (subgraph->internalBufferSize + 2) * sizeof(float));
+        subgraph->fifoFill = 0;
+    }
+}
+
+static int getLatency(void* instance) {
+    Subgraph* subgraph = (Subgraph*)instance;
+    if (!subgraph->up) {return 0;}
+
+    // the down filter delays by half its taps in outer samples
+    return subgraph->down->numTaps / 2 + resampler_latency(subgraph->up);
+}
+
+// the input is resampled or handed to the inner graph before the output is written
+static void processInPlace(void* instance, float* buffer, int numSamples) {
+    process(instance, buffer, buffer, numSamples);
+}
+
+AudioModuleInterface SubgraphModule = {
+    .create = create,
+    .destroy = destroy,
+    .init = init,
+    .process = process,
+    .setParameter = NULL,
+    .getParameter = NULL,
+    .reset = reset,
+    .getLatency = getLatency,
+    .processInPlace = processInPlace,
+};
+
+void subgraph_set_sample_rate(Subgraph *subgraph, int sampleRate) {
+    if (!subgraph || sampleRate < 0) {return;}
+    subgraph->internalRate = sampleRate;
+}
+
+void subgraph_set_output(Subgraph *subgraph, AudioNode *output) {
+    if (!subgraph) {return;}
+    subgraph->output = output;
+}
+
+static void teardown_rates(Subgraph *subgraph) {
+    destroy_resampler(subgraph->down);
+    destroy_resampler(subgraph->up);
+    free(subgraph->inputFifo);
+    subgraph->down = NULL;
+    subgraph->up = NULL;
+    subgraph->inputFifo = NULL;
+    subgraph->fifoFill = 0;
+}
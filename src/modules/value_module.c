@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "value_module.h"
+
+static void* create(void) {
+    Value* value = (Value*)calloc(1, sizeof(Value));
+    if (!value) {
+        fprintf(stderr, "Failed to allocate value");
+        return NULL;
+    }
+    return value;
+}
+
+static void destroy(void* instance) {
+    free(instance);
+}
+
+static void process(void* instance, const float* input, float* output, int numSamples) {
+    Value* value = (Value*)instance;
+    (void)input;
+    for (int i = 0; i < numSamples; i++) {
+        output[i] = value->value;
+    }
+}
+
+static void setParameter(void* instance, int parameterId, float newValue) {
+    Value* value = (Value*)instance;
+    switch (parameterId) {
+        case VALUE_PARAM:
+            value->value = newValue;
+            break;
+    }
+}
+
+static float getParameter(void* instance, int parameterId) {
+    Value* value = (Value*)instance;
+    switch (parameterId) {
+        case VALUE_PARAM: return value->value;
+        default: return 0.0f;
+    }
+}
+
+AudioModuleInterface ValueModule = {
+    .create = create,
+    .destroy = destroy,
+    .init = NULL,
+    .process = process,
+    .setParameter = setParameter,
+    .getParameter = getParameter,
+    .reset = NULL,
+    .rate = MODULE_RATE_EVENT,
+};
@@ -0,0 +1,298 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "cpu_features.h"
+
+#if defined(__SSE__) || defined(CPU_FEATURES_DISPATCH)
+#include <immintrin.h>
+#endif
+
+#include "resampler.h"
+
+// -6 dB point as a fraction of the lower Nyquist; the window's transition band ends just past it
+#define RESAMPLER_CUTOFF 0.93
+#define RESAMPLER_KAISER_BETA 7.0
+// input samples appended per pass before the history is shifted down
+#define RESAMPLER_BLOCK 1024
+#define RESAMPLER_SIMD_WIDTH 8
+
+static double bessel_i0(double x);
+static void design_filters(Resampler *resampler, double cutoff);
+typedef float (*DotProduct)(const float *a, const float *b, int n);
+
+static float dot_product(const float *a, const float *b, int n);
+static DotProduct select_dot_product(void);
+
+static int gcd(int a, int b) {
+    while (b != 0) {
+        const int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+Resampler* create_resampler(int inputRate, int outputRate) {
+    if (inputRate <= 0 || outputRate <= 0) {
+        fprintf(stderr, "Resampler rates must be positive\n");
+        return NULL;
+    }
+
+    Resampler *resampler = (Resampler*)calloc(1, sizeof(Resampler));
+    if (!resampler) {
+        fprintf(stderr, "Failed to allocate resampler\n");
+        return NULL;
+    }
+
+    const int divisor = gcd(inputRate, outputRate);
+    resampler->inputRate = inputRate / divisor;
+    resampler->outputRate = outputRate / divisor;
+
+    // decimation narrows the passband, so the filter has to get longer to keep its quality
+    const double bandwidth = outputRate < inputRate ? (double)outputRate / inputRate : 1.0;
+    int numTaps = (int)ceil(RESAMPLER_TAPS / bandwidth);
+    numTaps = (numTaps + RESAMPLER_SIMD_WIDTH - 1) / RESAMPLER_SIMD_WIDTH * RESAMPLER_SIMD_WIDTH;
+    resampler->numTaps = numTaps;
+
+    if (resampler->outputRate <= RESAMPLER_MAX_PHASES) {
+        resampler->numPhases = resampler->outputRate;
+        resampler->interpolate = false;
+    } else {
+        resampler->numPhases = RESAMPLER_MAX_PHASES;
+        resampler->interpolate = true;
+    }
+    resampler->phaseScale = (float)resampler->numPhases / resampler->outputRate;
+
+    // one extra phase lets interpolation read phase p + 1 without wrapping
+    const size_t numRows = resampler->numPhases + (resampler->interpolate ? 1 : 0);
+    resampler->filters = (float*)aligned_alloc(32, numRows * numTaps * sizeof(float));
+    resampler->bufferSize = numTaps - 1 + (numTaps > RESAMPLER_BLOCK ? numTaps : RESAMPLER_BLOCK);
+    resampler->buffer = (float*)malloc(resampler->bufferSize * sizeof(float));
+    if (!resampler->filters || !resampler->buffer) {
+        fprintf(stderr, "Failed to allocate resampler filters\n");
+        destroy_resampler(resampler);
+        return NULL;
+    }
+
+    design_filters(resampler, RESAMPLER_CUTOFF * bandwidth);
+    reset_resampler(resampler);
+    return resampler;
+}
+
+void destroy_resampler(Resampler *resampler) {
+    if (!resampler) {return;}
+
+    free(resampler->filters);
+    free(resampler->buffer);
+    free(resampler);
+}
+
+void reset_resampler(Resampler *resampler) {
+    memset(resampler->buffer, 0, resampler->bufferSize * sizeof(float));
+    resampler->fill = resampler->numTaps - 1;
+    resampler->index = resampler->numTaps - 1;
+    resampler->frac = 0;
+}
+
+int resampler_max_output(const Resampler *resampler, int numInput) {
+    // outputs whose position lands before the end of the buffered input
+    const long long end = (long long)(resampler->fill + numInput) * resampler->outputRate;
+    const long long position = (long long)resampler->index * resampler->outputRate + resampler->frac;
+    if (end <= position) {return 0;}
+    return (int)((end - position + resampler->inputRate - 1) / resampler->inputRate);
+}
+
+int resampler_input_needed(const Resampler *resampler, int numOutput) {
+    if (numOutput <= 0) {return 0;}
+
+    const long long last = (long long)resampler->index * resampler->outputRate + resampler->frac +
+                           (long long)(numOutput - 1) * resampler->inputRate;
+    const long long needed = last / resampler->outputRate + 1 - resampler->fill;
+    return needed > 0 ? (int)needed : 0;
+}
+
+int resampler_latency(const Resampler *resampler) {
+    return (int)lround((double)(resampler->numTaps / 2) * resampler->outputRate / resampler->inputRate);
+}
+
+int resampler_process(Resampler *resampler, const float *input, int numInput, float *output, int maxOutput) {
+    const int numTaps = resampler->numTaps;
+    const int indexStep = resampler->inputRate / resampler->outputRate;
+    const int fracStep = resampler->inputRate % resampler->outputRate;
+    const int outputRate = resampler->outputRate;
+    float *buffer = resampler->buffer;
+    const DotProduct dot = select_dot_product();
+    int produced = 0;
+
+    for (;;) {
+        int index = resampler->index;
+        int frac = resampler->frac;
+
+        while (index < resampler->fill && produced < maxOutput) {
+            const float *window = buffer + index - numTaps + 1;
+
+            if (resampler->interpolate) {
+                const float position = frac * resampler->phaseScale;
+                const int phase = (int)position;
+                const float *filter = resampler->filters + (size_t)phase * numTaps;
+                const float a = dot(filter, window, numTaps);
+                const float b = dot(filter + numTaps, window, numTaps);
+                output[produced++] = a + (b - a) * (position - phase);
+            } else {
+                output[produced++] = dot(resampler->filters + (size_t)frac * numTaps, window, numTaps);
+            }
+
+            index += indexStep;
+            frac += fracStep;
+            if (frac >= outputRate) {
+                frac -= outputRate;
+                index++;
+            }
+        }
+        resampler->frac = frac;
+
+        // keep only the history the next output still reads
+        const int drop = index - (numTaps - 1);
+        if (drop > 0) {
+            memmove(buffer, buffer + drop, (resampler->fill - drop) * sizeof(float));
+            resampler->fill -= drop;
+            index -= drop;
+        }
+        resampler->index = index;
+
+        int count = resampler->bufferSize - resampler->fill;
+        if (count > numInput) {count = numInput;}
+        if (count <= 0) {break;}
+
+        memcpy(buffer + resampler->fill, input, count * sizeof(float));
+        resampler->fill += count;
+        input += count;
+        numInput -= count;
+    }
+    return produced;
+}
+
+float* resample_buffer(const float *input, int length, int inputRate, int outputRate, int *outputLength) {
+    Resampler *resampler = create_resampler(inputRate, outputRate);
+    if (!resampler) {return NULL;}
+
+    const int latency = resampler_latency(resampler);
+    const int numOutput = (int)(((long long)length * outputRate + inputRate - 1) / inputRate);
+    const int numInput = resampler_input_needed(resampler, latency + numOutput);
+
+    // the input is zero padded so the filter delay flushes out the end
+    float *padded = (float*)calloc(numInput > length ? numInput : length, sizeof(float));
+    float *output = (float*)malloc((size_t)(latency + numOutput) * sizeof(float));
+    if (!padded || !output) {
+        fprintf(stderr, "Failed to allocate resampled buffer\n");
+        free(padded);
+        free(output);
+        destroy_resampler(resampler);
+        return NULL;
+    }
+    memcpy(padded, input, length * sizeof(float));
+
+    resampler_process(resampler, padded, numInput, output, latency + numOutput);
+    memmove(output, output + latency, numOutput * sizeof(float));
+
+    free(padded);
+    destroy_resampler(resampler);
+    *outputLength = numOutput;
+    return output;
+}
+
+static double bessel_i0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 50 && term > sum * 1e-12; k++) {
+        const double t = x / (2.0 * k);
+        term *= t * t;
+        sum += term;
+    }
+    return sum;
+}
+
+/*
+ * Row p holds the taps for an output p/numPhases of a sample past the
+ * newest input, ordered oldest input first so each output is a plain dot
+ * product with the history. Rows are normalised to unity gain at DC.
+ */
+static void design_filters(Resampler *resampler, double cutoff) {
+    const int numTaps = resampler->numTaps;
+    const double halfLength = numTaps / 2;
+    const double windowNorm = bessel_i0(RESAMPLER_KAISER_BETA);
+    const int numRows = resampler->numPhases + (resampler->interpolate ? 1 : 0);
+
+    for (int p = 0; p < numRows; p++) {
+        float *row = resampler->filters + (size_t)p * numTaps;
+        const double phase = (double)p / resampler->numPhases;
+        double sum = 0.0;
+
+        for (int i = 0; i < numTaps; i++) {
+            const double t = phase + halfLength - 1 - i;
+            const double x = t / halfLength;
+            const double window = (fabs(x) < 1.0)
+                ? bessel_i0(RESAMPLER_KAISER_BETA * sqrt(1.0 - x * x)) / windowNorm
+                : 0.0;
+            const double arg = M_PI * cutoff * t;
+            const double sinc = (fabs(arg) < 1e-12) ? 1.0 : sin(arg) / arg;
+            const double h = cutoff * sinc * window;
+            row[i] = (float)h;
+            sum += h;
+        }
+
+        for (int i = 0; i < numTaps; i++) {
+            row[i] = (float)(row[i] / sum);
+        }
+    }
+}
+
+#if defined(CPU_FEATURES_DISPATCH)
+__attribute__((target("avx,fma")))
+static float dot_product_fma(const float *a, const float *b, int n) {
+    int i = 0;
+    __m256 acc = _mm256_setzero_ps();
+    for (; i + 8 <= n; i += 8) {
+        acc = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc);
+    }
+    __m128 acc4 = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    acc4 = _mm_add_ps(acc4, _mm_movehl_ps(acc4, acc4));
+    acc4 = _mm_add_ss(acc4, _mm_shuffle_ps(acc4, acc4, 1));
+    float sum = _mm_cvtss_f32(acc4);
+
+    for (; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+#endif
+
+static float dot_product(const float *a, const float *b, int n) {
+    int i = 0;
+    float sum = 0.0f;
+
+#if defined(__SSE__)
+    __m128 acc4 = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4) {
+        acc4 = _mm_add_ps(acc4, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+    acc4 = _mm_add_ps(acc4, _mm_movehl_ps(acc4, acc4));
+    acc4 = _mm_add_ss(acc4, _mm_shuffle_ps(acc4, acc4, 1));
+    sum = _mm_cvtss_f32(acc4);
+#endif
+
+    for (; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+// chosen once per call to resampler_process rather than once per output
+static DotProduct select_dot_product(void) {
+#if defined(CPU_FEATURES_DISPATCH)
+    if (cpu_has_fma()) {return dot_product_fma;}
+#endif
+    return dot_product;
+}
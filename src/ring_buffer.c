@@ -0,0 +1,139 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ring_buffer.h"
+
+static void fill_region(RingBuffer *rb, size_t pos, int numFrames, RingBufferRegion *region);
+
+RingBuffer* create_ring_buffer(int minFrames, int channels) {
+    if (minFrames < 1 || channels < 1) {return NULL;}
+
+    // aligned_alloc wants a size that is a multiple of the alignment
+    const size_t size = (sizeof(RingBuffer) + RING_BUFFER_CACHE_LINE - 1) & ~(size_t)(RING_BUFFER_CACHE_LINE - 1);
+    RingBuffer *rb = (RingBuffer*)aligned_alloc(RING_BUFFER_CACHE_LINE, size);
+    if (!rb) {
+        fprintf(stderr, "Failed to allocate ring buffer\n");
+        return NULL;
+    }
+    memset(rb, 0, sizeof(RingBuffer));
+
+    size_t capacity = 1;
+    while (capacity < (size_t)minFrames) {capacity <<= 1;}
+
+    rb->capacity = capacity;
+    rb->mask = capacity - 1;
+    rb->channels = channels;
+    rb->buffer = (float*)calloc(capacity * channels, sizeof(float));
+    if (!rb->buffer) {
+        fprintf(stderr, "Failed to allocate ring buffer storage\n");
+        free(rb);
+        return NULL;
+    }
+
+    atomic_init(&rb->writePos, 0);
+    atomic_init(&rb->readPos, 0);
+    rb->cachedReadPos = 0;
+    rb->cachedWritePos = 0;
+    return rb;
+}
+
+void destroy_ring_buffer(RingBuffer *rb) {
+    if (!rb) {return;}
+
+    free(rb->buffer);
+    free(rb);
+}
+
+int ring_buffer_write_available(RingBuffer *rb) {
+    const size_t writePos = atomic_load_explicit(&rb->writePos, memory_order_relaxed);
+    rb->cachedReadPos = atomic_load_explicit(&rb->readPos, memory_order_acquire);
+    return (int)(rb->capacity - (writePos - rb->cachedReadPos));
+}
+
+int ring_buffer_acquire_write(RingBuffer *rb, int numFrames, RingBufferRegion *region) {
+    const size_t writePos = atomic_load_explicit(&rb->writePos, memory_order_relaxed);
+
+    size_t space = rb->capacity - (writePos - rb->cachedReadPos);
+    if (space < (size_t)numFrames) {
+        rb->cachedReadPos = atomic_load_explicit(&rb->readPos, memory_order_acquire);
+        space = rb->capacity - (writePos - rb->cachedReadPos);
+    }
+    if ((size_t)numFrames > space) {numFrames = (int)space;}
+
+    fill_region(rb, writePos, numFrames, region);
+    return numFrames;
+}
+
+void ring_buffer_commit_write(RingBuffer *rb, int numFrames) {
+    const size_t writePos = atomic_load_explicit(&rb->writePos, memory_order_relaxed);
+    atomic_store_explicit(&rb->writePos, writePos + numFrames, memory_order_release);
+}
+
+bool ring_buffer_write(RingBuffer *rb, const float *frames, int numFrames) {
+    RingBufferRegion region;
+    if (ring_buffer_acquire_write(rb, numFrames, &region) < numFrames) {return false;}
+
+    const size_t firstSamples = (size_t)region.frames[0] * rb->channels;
+    memcpy(region.data[0], frames, firstSamples * sizeof(float));
+    if (region.frames[1] > 0) {
+        memcpy(region.data[1], frames + firstSamples, (size_t)region.frames[1] * rb->channels * sizeof(float));
+    }
+
+    ring_buffer_commit_write(rb, numFrames);
+    return true;
+}
+
+int ring_buffer_read_available(RingBuffer *rb) {
+    const size_t readPos = atomic_load_explicit(&rb->readPos, memory_order_relaxed);
+    rb->cachedWritePos = atomic_load_explicit(&rb->writePos, memory_order_acquire);
+    return (int)(rb->cachedWritePos - readPos);
+}
+
+int ring_buffer_acquire_read(RingBuffer *rb, int numFrames, RingBufferRegion *region) {
+    const size_t readPos = atomic_load_explicit(&rb->readPos, memory_order_relaxed);
+
+    size_t available = rb->cachedWritePos - readPos;
+    if (available < (size_t)numFrames) {
+        rb->cachedWritePos = atomic_load_explicit(&rb->writePos, memory_order_acquire);
+        available = rb->cachedWritePos - readPos;
+    }
+    if ((size_t)numFrames > available) {numFrames = (int)available;}
+
+    fill_region(rb, readPos, numFrames, region);
+    return numFrames;
+}
+
+void ring_buffer_commit_read(RingBuffer *rb, int numFrames) {
+    const size_t readPos = atomic_load_explicit(&rb->readPos, memory_order_relaxed);
+    atomic_store_explicit(&rb->readPos, readPos + numFrames, memory_order_release);
+}
+
+bool ring_buffer_read(RingBuffer *rb, float *frames, int numFrames) {
+    RingBufferRegion region;
+    if (ring_buffer_acquire_read(rb, numFrames, &region) < numFrames) {return false;}
+
+    const size_t firstSamples = (size_t)region.frames[0] * rb->channels;
+    memcpy(frames, region.data[0], firstSamples * sizeof(float));
+    if (region.frames[1] > 0) {
+        memcpy(frames + firstSamples, region.data[1], (size_t)region.frames[1] * rb->channels * sizeof(float));
+    }
+
+    ring_buffer_commit_read(rb, numFrames);
+    return true;
+}
+
+static void fill_region(RingBuffer *rb, size_t pos, int numFrames, RingBufferRegion *region) {
+    const size_t start = pos & rb->mask;
+    const size_t toEnd = rb->capacity - start;
+
+    region->data[0] = rb->buffer + start * rb->channels;
+    region->data[1] = rb->buffer;
+    if ((size_t)numFrames <= toEnd) {
+        region->frames[0] = numFrames;
+        region->frames[1] = 0;
+    } else {
+        region->frames[0] = (int)toEnd;
+        region->frames[1] = numFrames - (int)toEnd;
+    }
+}
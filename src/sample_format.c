@@ -0,0 +1,183 @@
+#include <math.h>
+#include <string.h>
+
+#include "cpu_features.h"
+
+#if defined(__SSE2__) || defined(CPU_FEATURES_DISPATCH)
+#include <immintrin.h>
+#endif
+
+#include "sample_format.h"
+
+#define INT16_SCALE (32768.0f / SAMPLE_INT16_RANGE)
+
+bool sample_format_vectorized(SampleFormat format) {
+    switch (format) {
+        case SAMPLE_FORMAT_INT16:
+#if defined(__SSE2__)
+            return true;
+#else
+            return false;
+#endif
+        case SAMPLE_FORMAT_HALF:
+            return cpu_has_f16c();
+        default:
+            return true;
+    }
+}
+
+int sample_format_size(SampleFormat format) {
+    switch (format) {
+        case SAMPLE_FORMAT_INT16:
+        case SAMPLE_FORMAT_HALF:
+            return 2;
+        default:
+            return (int)sizeof(float);
+    }
+}
+
+/* INT16 */
+
+void float_to_int16(const float *input, int16_t *output, int numSamples) {
+    int i = 0;
+
+#if defined(__SSE2__)
+    const __m128 scale = _mm_set1_ps(INT16_SCALE);
+    // clamp before converting, cvtps gives INT_MIN for anything out of int32 range
+    const __m128 lo = _mm_set1_ps(-32768.0f);
+    const __m128 hi = _mm_set1_ps(32767.0f);
+    for (; i + 8 <= numSamples; i += 8) {
+        const __m128 a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(input + i), scale), lo), hi);
+        const __m128 b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(input + i + 4), scale), lo), hi);
+        const __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+        _mm_storeu_si128((__m128i*)(output + i), packed);
+    }
+#endif
+
+    for (; i < numSamples; i++) {
+        float v = input[i] * INT16_SCALE;
+        if (!(v > -32768.0f)) {v = -32768.0f;}
+        if (v > 32767.0f) {v = 32767.0f;}
+        output[i] = (int16_t)lrintf(v);
+    }
+}
+
+void int16_accumulate(const int16_t *input, float *output, float gain, int numSamples) {
+    const float g = gain / INT16_SCALE;
+    int i = 0;
+
+#if defined(__SSE2__)
+    const __m128 scale = _mm_set1_ps(g);
+    for (; i + 8 <= numSamples; i += 8) {
+        const __m128i v = _mm_loadu_si128((const __m128i*)(input + i));
+        // duplicate each sample into a 32-bit lane, then sign-extend by shifting
+        const __m128i a = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        const __m128i b = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(output + i, _mm_add_ps(_mm_loadu_ps(output + i), _mm_mul_ps(_mm_cvtepi32_ps(a), scale)));
+        _mm_storeu_ps(output + i + 4, _mm_add_ps(_mm_loadu_ps(output + i + 4), _mm_mul_ps(_mm_cvtepi32_ps(b), scale)));
+    }
+#endif
+
+    for (; i < numSamples; i++) {
+        output[i] += input[i] * g;
+    }
+}
+
+float int16_sample(int16_t value) {
+    return value * (1.0f / INT16_SCALE);
+}
+
+/* HALF */
+
+// rounds to nearest even like the hardware conversion
+static uint16_t float_to_half_scalar(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+    uint32_t magnitude = bits & 0x7fffffff;
+
+    if (magnitude >= 0x7f800000) {
+        return sign | (magnitude > 0x7f800000 ? 0x7e00 : 0x7c00);
+    }
+    // 65520 and up round past the largest half
+    if (magnitude >= 0x477ff000) {return sign | 0x7c00;}
+    if (magnitude < 0x38800000) {
+        // subnormal halves count in steps of 2^-24
+        float small;
+        memcpy(&small, &magnitude, sizeof(small));
+        return sign | (uint16_t)lrintf(small * 16777216.0f);
+    }
+
+    // rebias the exponent from 127 to 15 and round off 13 mantissa bits
+    magnitude += ((uint32_t)(15 - 127) << 23) + 0xfff + ((magnitude >> 13) & 1);
+    return sign | (uint16_t)(magnitude >> 13);
+}
+
+#if defined(CPU_FEATURES_DISPATCH)
+// both return how many samples they converted, leaving the tail to the caller
+__attribute__((target("avx,f16c")))
+static int float_to_half_f16c(const float *input, uint16_t *output, int numSamples) {
+    int i = 0;
+    for (; i + 8 <= numSamples; i += 8) {
+        const __m128i packed = _mm256_cvtps_ph(_mm256_loadu_ps(input + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128((__m128i*)(output + i), packed);
+    }
+    return i;
+}
+
+__attribute__((target("avx,f16c")))
+static int half_accumulate_f16c(const uint16_t *input, float *output, float gain, int numSamples) {
+    const __m256 scale = _mm256_set1_ps(gain);
+    int i = 0;
+    for (; i + 8 <= numSamples; i += 8) {
+        const __m256 v = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(input + i)));
+        _mm256_storeu_ps(output + i, _mm256_add_ps(_mm256_loadu_ps(output + i), _mm256_mul_ps(v, scale)));
+    }
+    return i;
+}
+#endif
+
+void float_to_half(const float *input, uint16_t *output, int numSamples) {
+    int i = 0;
+
+#if defined(CPU_FEATURES_DISPATCH)
+    if (cpu_has_f16c()) {i = float_to_half_f16c(input, output, numSamples);}
+#endif
+
+    for (; i < numSamples; i++) {
+        output[i] = float_to_half_scalar(input[i]);
+    }
+}
+
+void half_accumulate(const uint16_t *input, float *output, float gain, int numSamples) {
+    int i = 0;
+
+#if defined(CPU_FEATURES_DISPATCH)
+    if (cpu_has_f16c()) {i = half_accumulate_f16c(input, output, gain, numSamples);}
+#endif
+
+    for (; i < numSamples; i++) {
+        output[i] += half_sample(input[i]) * gain;
+    }
+}
+
+float half_sample(uint16_t value) {
+    const uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+    const uint32_t exponent = (value >> 10) & 0x1f;
+    const uint32_t mantissa = value & 0x3ff;
+    uint32_t bits;
+
+    if (exponent == 0) {
+        const float magnitude = mantissa * (1.0f / 16777216.0f);
+        return sign ? -magnitude : magnitude;
+    }
+    if (exponent == 31) {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    } else {
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
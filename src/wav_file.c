@@ -0,0 +1,380 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "cpu_features.h"
+
+#if defined(__SSE2__) || defined(CPU_FEATURES_DISPATCH)
+#include <immintrin.h>
+#endif
+
+#include "wav_file.h"
+
+#define WAVE_FORMAT_PCM 0x0001
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+static uint16_t read_u16(const unsigned char *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t read_u32(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+bool parse_wav_header(const unsigned char *data, size_t size, WavInfo *info) {
+    if (!data || !info || size < 12) {return false;}
+
+    if (memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0) {
+        fprintf(stderr, "Not a RIFF/WAVE file\n");
+        return false;
+    }
+
+    bool haveFormat = false;
+    int formatTag = 0;
+    int bitsPerSample = 0;
+    size_t pos = 12;
+
+    while (pos + 8 <= size) {
+        const unsigned char *chunk = data + pos;
+        const size_t chunkSize = read_u32(chunk + 4);
+        const size_t body = pos + 8;
+
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            if (chunkSize < 16 || body + chunkSize > size) {
+                fprintf(stderr, "Malformed wav format chunk\n");
+                return false;
+            }
+            formatTag = read_u16(data + body);
+            info->numChannels = read_u16(data + body + 2);
+            info->sampleRate = (int)read_u32(data + body + 4);
+            info->bytesPerFrame = read_u16(data + body + 12);
+            bitsPerSample = read_u16(data + body + 14);
+
+            if (formatTag == WAVE_FORMAT_EXTENSIBLE && chunkSize >= 26) {
+                formatTag = read_u16(data + body + 24);
+            }
+            haveFormat = true;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (!haveFormat) {
+                fprintf(stderr, "Wav data chunk precedes format chunk\n");
+                return false;
+            }
+            if (formatTag == WAVE_FORMAT_PCM && bitsPerSample == 16) {
+                info->format = WAV_FORMAT_PCM16;
+            } else if (formatTag == WAVE_FORMAT_PCM && bitsPerSample == 24) {
+                info->format = WAV_FORMAT_PCM24;
+            } else if (formatTag == WAVE_FORMAT_PCM && bitsPerSample == 32) {
+                info->format = WAV_FORMAT_PCM32;
+            } else if (formatTag == WAVE_FORMAT_IEEE_FLOAT && bitsPerSample == 32) {
+                info->format = WAV_FORMAT_FLOAT32;
+            } else {
+                fprintf(stderr, "Unsupported wav format %d with %d bits\n", formatTag, bitsPerSample);
+                return false;
+            }
+            if (info->numChannels <= 0 ||
+                info->bytesPerFrame != info->numChannels * (bitsPerSample / 8)) {
+                fprintf(stderr, "Malformed wav frame layout\n");
+                return false;
+            }
+
+            // tolerate truncated files and streaming writers that leave the size unset
+            size_t available = size - body;
+            if (chunkSize < available) {available = chunkSize;}
+
+            info->dataOffset = body;
+            info->numFrames = (int)(available / info->bytesPerFrame);
+            return true;
+        }
+
+        pos = body + chunkSize + (chunkSize & 1);
+    }
+
+    fprintf(stderr, "Wav file has no data chunk\n");
+    return false;
+}
+
+// one sample before scaling to [-1, 1]
+static float read_raw_sample(WavSampleFormat format, const unsigned char *p) {
+    switch (format) {
+        case WAV_FORMAT_PCM16:
+            return (int16_t)read_u16(p);
+        case WAV_FORMAT_PCM24: {
+            const int32_t v = (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24));
+            return v >> 8;
+        }
+        case WAV_FORMAT_PCM32:
+            return (float)(int32_t)read_u32(p);
+        default: {
+            float value;
+            memcpy(&value, p, sizeof(value));
+            return value;
+        }
+    }
+}
+
+#if defined(CPU_FEATURES_DISPATCH)
+/*
+ * 24-bit samples need a byte shuffle to widen, so these are built for
+ * SSSE3 and chosen at run time. Each sample lands in the top three bytes
+ * of a 32-bit lane and an arithmetic shift sign-extends it. Both return
+ * how many frames they converted and stop early enough that their 16-byte
+ * loads stay inside numFrames.
+ */
+__attribute__((target("ssse3")))
+static int pcm24_channel_ssse3(const unsigned char *p, int stride, float *output, int numFrames) {
+    const __m128 scale = _mm_set1_ps(1.0f / 8388608.0f);
+    int i = 0;
+
+    if (stride == 3) {
+        const __m128i widen = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+        for (; i + 6 <= numFrames; i += 4, p += 12) {
+            const __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)p), widen);
+            _mm_storeu_ps(output + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(v, 8)), scale));
+        }
+    } else if (stride == 6) {
+        // two frames per load, into the low and the high half
+        const __m128i low = _mm_setr_epi8(-1, 0, 1, 2, -1, 6, 7, 8, -1, -1, -1, -1, -1, -1, -1, -1);
+        const __m128i high = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 1, 2, -1, 6, 7, 8);
+        for (; i + 6 <= numFrames; i += 4, p += 24) {
+            const __m128i a = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)p), low);
+            const __m128i b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(p + 12)), high);
+            const __m128i v = _mm_or_si128(a, b);
+            _mm_storeu_ps(output + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(v, 8)), scale));
+        }
+    }
+    return i;
+}
+
+__attribute__((target("ssse3")))
+static int pcm24_stereo_mix_ssse3(const unsigned char *p, float *output, int numFrames) {
+    const __m128 scale = _mm_set1_ps(0.5f / 8388608.0f);
+    const __m128i widen = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    int i = 0;
+
+    for (; i + 5 <= numFrames; i += 4, p += 24) {
+        // left, right, left, right of two frames each
+        const __m128 a = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)p), widen), 8));
+        const __m128 b = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(p + 12)), widen), 8));
+        const __m128 left = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m128 right = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(output + i, _mm_mul_ps(_mm_add_ps(left, right), scale));
+    }
+    return i;
+}
+#endif
+
+#if defined(__SSE2__)
+// picks one channel out of four interleaved stereo pairs
+static __m128 select_channel(__m128 a, __m128 b, int channel) {
+    return channel == 0 ? _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))
+                        : _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+}
+#endif
+
+void convert_wav_channel(const WavInfo *info, const unsigned char *frames,
+                         int channel, float *output, int numFrames) {
+    const int stride = info->bytesPerFrame;
+    int i = 0;
+
+    switch (info->format) {
+        case WAV_FORMAT_PCM16: {
+            const unsigned char *p = frames + channel * 2;
+#if defined(__SSE2__)
+            const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+            if (stride == 2) {
+                for (; i + 8 <= numFrames; i += 8, p += 16) {
+                    const __m128i v = _mm_loadu_si128((const __m128i*)p);
+                    // duplicate each sample into a 32-bit lane, then sign-extend by shifting
+                    const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+                    const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+                    _mm_storeu_ps(output + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+                    _mm_storeu_ps(output + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+                }
+            } else if (stride == 4) {
+                // loading from the channel's own offset puts its samples in the low half of
+                // every lane; the load reaches into the next frame, so one is kept in reserve
+                for (; i + 5 <= numFrames; i += 4, p += 16) {
+                    const __m128i v = _mm_loadu_si128((const __m128i*)p);
+                    const __m128i samples = _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+                    _mm_storeu_ps(output + i, _mm_mul_ps(_mm_cvtepi32_ps(samples), scale));
+                }
+            }
+#endif
+            for (; i < numFrames; i++, p += stride) {
+                output[i] = (int16_t)read_u16(p) * (1.0f / 32768.0f);
+            }
+            break;
+        }
+        case WAV_FORMAT_PCM24: {
+            const unsigned char *p = frames + channel * 3;
+#if defined(CPU_FEATURES_DISPATCH)
+            if ((stride == 3 || stride == 6) && cpu_has_ssse3()) {
+                i = pcm24_channel_ssse3(p, stride, output, numFrames);
+                p += (size_t)i * stride;
+            }
+#endif
+            for (; i < numFrames; i++, p += stride) {
+                const int32_t v = (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24));
+                output[i] = (v >> 8) * (1.0f / 8388608.0f);
+            }
+            break;
+        }
+        case WAV_FORMAT_PCM32: {
+            const unsigned char *p = frames + channel * 4;
+#if defined(__SSE2__)
+            const __m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+            if (stride == 4) {
+                for (; i + 4 <= numFrames; i += 4, p += 16) {
+                    const __m128i v = _mm_loadu_si128((const __m128i*)p);
+                    _mm_storeu_ps(output + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+                }
+            } else if (stride == 8) {
+                const unsigned char *q = frames;
+                for (; i + 4 <= numFrames; i += 4, q += 32, p += 32) {
+                    const __m128 a = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)q));
+                    const __m128 b = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(q + 16)));
+                    _mm_storeu_ps(output + i, _mm_mul_ps(select_channel(a, b, channel), scale));
+                }
+            }
+#endif
+            for (; i < numFrames; i++, p += stride) {
+                output[i] = (int32_t)read_u32(p) * (1.0f / 2147483648.0f);
+            }
+            break;
+        }
+        case WAV_FORMAT_FLOAT32: {
+            const unsigned char *p = frames + channel * 4;
+            if (stride == 4) {
+                memcpy(output, p, numFrames * sizeof(float));
+                break;
+            }
+#if defined(__SSE2__)
+            if (stride == 8) {
+                const unsigned char *q = frames;
+                for (; i + 4 <= numFrames; i += 4, q += 32, p += 32) {
+                    const __m128 a = _mm_loadu_ps((const float*)q);
+                    const __m128 b = _mm_loadu_ps((const float*)(q + 16));
+                    _mm_storeu_ps(output + i, select_channel(a, b, channel));
+                }
+            }
+#endif
+            for (; i < numFrames; i++, p += stride) {
+                memcpy(&output[i], p, sizeof(float));
+            }
+            break;
+        }
+    }
+}
+
+void convert_wav_mono(const WavInfo *info, const unsigned char *frames, float *output, int numFrames) {
+    if (info->numChannels == 1) {
+        convert_wav_channel(info, frames, 0, output, numFrames);
+        return;
+    }
+
+    const int stride = info->bytesPerFrame;
+    const unsigned char *p = frames;
+    int i = 0;
+
+    if (info->numChannels == 2) {
+        switch (info->format) {
+            case WAV_FORMAT_PCM16: {
+#if defined(__SSE2__)
+                // pmaddwd adds each left and right pair into one 32-bit lane
+                const __m128i ones = _mm_set1_epi16(1);
+                const __m128 scale = _mm_set1_ps(0.5f / 32768.0f);
+                for (; i + 4 <= numFrames; i += 4, p += 16) {
+                    const __m128i sums = _mm_madd_epi16(_mm_loadu_si128((const __m128i*)p), ones);
+                    _mm_storeu_ps(output + i, _mm_mul_ps(_mm_cvtepi32_ps(sums), scale));
+                }
+#endif
+                break;
+            }
+            case WAV_FORMAT_PCM24: {
+#if defined(CPU_FEATURES_DISPATCH)
+                if (cpu_has_ssse3()) {
+                    i = pcm24_stereo_mix_ssse3(p, output, numFrames);
+                    p += (size_t)i * stride;
+                }
+#endif
+                break;
+            }
+            case WAV_FORMAT_PCM32:
+            case WAV_FORMAT_FLOAT32: {
+#if defined(__SSE2__)
+                const bool integer = info->format == WAV_FORMAT_PCM32;
+                const __m128 scale = _mm_set1_ps(integer ? 0.5f / 2147483648.0f : 0.5f);
+                for (; i + 4 <= numFrames; i += 4, p += 32) {
+                    __m128 a, b;
+                    if (integer) {
+                        a = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)p));
+                        b = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(p + 16)));
+                    } else {
+                        a = _mm_loadu_ps((const float*)p);
+                        b = _mm_loadu_ps((const float*)(p + 16));
+                    }
+                    const __m128 sum = _mm_add_ps(select_channel(a, b, 0), select_channel(a, b, 1));
+                    _mm_storeu_ps(output + i, _mm_mul_ps(sum, scale));
+                }
+#endif
+                break;
+            }
+        }
+    }
+
+    // sums in the same order and scales the same way as the vector loops
+    const int bytesPerSample = stride / info->numChannels;
+    const float channelScale = 1.0f / info->numChannels;
+    const float rawScale = info->format == WAV_FORMAT_PCM16 ? 1.0f / 32768.0f :
+                           info->format == WAV_FORMAT_PCM24 ? 1.0f / 8388608.0f :
+                           info->format == WAV_FORMAT_PCM32 ? 1.0f / 2147483648.0f : 1.0f;
+    for (; i < numFrames; i++, p += stride) {
+        float sum = 0.0f;
+        for (int c = 0; c < info->numChannels; c++) {
+            sum += read_raw_sample(info->format, p + c * bytesPerSample);
+        }
+        output[i] = sum * (rawScale * channelScale);
+    }
+}
+
+float* load_wav_mono(const char *path, int *numFrames, int *sampleRate) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    const long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    unsigned char *data = (fileSize > 0) ? (unsigned char*)malloc(fileSize) : NULL;
+    if (!data || fread(data, 1, fileSize, file) != (size_t)fileSize) {
+        fprintf(stderr, "Failed to read %s\n", path);
+        free(data);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+
+    WavInfo info;
+    if (!parse_wav_header(data, fileSize, &info)) {
+        free(data);
+        return NULL;
+    }
+
+    float *mono = (float*)calloc(info.numFrames > 0 ? info.numFrames : 1, sizeof(float));
+    if (!mono) {
+        fprintf(stderr, "Failed to allocate wav samples\n");
+        free(data);
+        return NULL;
+    }
+    convert_wav_mono(&info, data + info.dataOffset, mono, info.numFrames);
+    free(data);
+
+    *numFrames = info.numFrames;
+    *sampleRate = info.sampleRate;
+    return mono;
+}
@@ -0,0 +1,112 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "audio_graph.h"
+#include "sine_osc_module.h"
+#include "output_module.h"
+#include "convolution_reverb_module.h"
+
+/*
+ * Renders a reverb with a long impulse response twice, once offline with
+ * the tail partitions run inline and once paced in real time with the
+ * worker thread, and expects the same output with no tail block missed.
+ * This depends on wall-clock time, so it is kept out of the golden suite.
+ */
+
+#define TEST_SAMPLE_RATE 44100
+#define TEST_BLOCK_SIZE 128
+#define IR_LENGTH 20000
+#define NUM_BLOCKS 384
+
+static uint32_t rng_state;
+
+static float next_random(void) {
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return (float)(rng_state >> 8) / 16777216.0f * 2.0f - 1.0f;
+}
+
+// renders NUM_BLOCKS blocks into samples and returns the tail blocks the worker missed
+static int render(bool paced, float *samples) {
+    float *ir = (float*)malloc(IR_LENGTH * sizeof(float));
+    rng_state = 1;
+    for (int i = 0; i < IR_LENGTH; i++) {
+        ir[i] = next_random() * expf(-(float)i / (IR_LENGTH / 4)) * 0.05f;
+    }
+
+    AudioGraph *graph = create_audio_graph();
+    AudioNode *osc = create_audio_node(&SineOscillatorModule);
+    AudioNode *reverb = create_audio_node(&ConvolutionReverbModule);
+    AudioNode *out = create_audio_node(&OutputNodeModule);
+    add_node(graph, osc);
+    add_node(graph, reverb);
+    add_node(graph, out);
+
+    ConvolutionReverb *state = (ConvolutionReverb*)reverb->instance;
+    convolution_reverb_set_ir(state, ir, IR_LENGTH, TEST_SAMPLE_RATE);
+    convolution_reverb_set_offline(state, !paced);
+    osc->interface->setParameter(osc->instance, OSC_FREQUENCY_PARAM, 330.0f);
+    osc->interface->setParameter(osc->instance, OSC_GAIN_PARAM, 1.0f);
+    reverb->interface->setParameter(reverb->instance, CONV_DRY_PARAM, 0.5f);
+    connect_nodes(graph, osc, reverb);
+    connect_nodes(graph, reverb, out);
+    init_graph(graph, TEST_SAMPLE_RATE, TEST_BLOCK_SIZE);
+
+    // one block per period of real time, as an audio callback would
+    const long periodNs = (long)TEST_BLOCK_SIZE * 1000000000L / TEST_SAMPLE_RATE;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    const float *output = ((OutputNode*)out->instance)->outputs[0];
+    for (int b = 0; b < NUM_BLOCKS; b++) {
+        // silence the source halfway so the decaying tail is covered too
+        if (b == NUM_BLOCKS / 2) {
+            osc->interface->setParameter(osc->instance, OSC_GAIN_PARAM, 0.0f);
+        }
+        process_graph(graph, TEST_BLOCK_SIZE);
+        memcpy(samples + b * TEST_BLOCK_SIZE, output, TEST_BLOCK_SIZE * sizeof(float));
+
+        if (!paced) {continue;}
+        next.tv_nsec += periodNs;
+        if (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+
+    const int overruns = atomic_load(&state->overruns);
+    destroy_audio_graph(graph);
+    free(ir);
+    return overruns;
+}
+
+int main(void) {
+    static float offline[NUM_BLOCKS * TEST_BLOCK_SIZE];
+    static float realtime[NUM_BLOCKS * TEST_BLOCK_SIZE];
+    bool ok = true;
+
+    render(false, offline);
+    const int overruns = render(true, realtime);
+    if (overruns > 0) {
+        fprintf(stderr, "FAIL convolution worker missed %d tail blocks\n", overruns);
+        ok = false;
+    }
+
+    float worst = 0.0f;
+    for (int i = 0; i < NUM_BLOCKS * TEST_BLOCK_SIZE; i++) {
+        const float error = fabsf(realtime[i] - offline[i]);
+        if (error > worst) {worst = error;}
+    }
+    if (!(worst <= 1e-6f)) {
+        fprintf(stderr, "FAIL real-time render differs from offline by %g\n", worst);
+        ok = false;
+    }
+
+    if (!ok) {return 1;}
+    printf("PASS convolution_reverb real-time render matches offline\n");
+    return 0;
+}
@@ -0,0 +1,600 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "audio_graph.h"
+#include "sine_osc_module.h"
+#include "lowpass_filter_module.h"
+#include "output_module.h"
+#include "convolution_reverb_module.h"
+#include "sampler_module.h"
+#include "value_module.h"
+
+/*
+ * Renders fixed graphs offline and compares them against golden buffers
+ * stored as raw little-endian float32 in tests/golden/<name>.f32.
+ *
+ *   golden_test <scenario|all> <golden_dir>            compare
+ *   golden_test --update <scenario|all> <golden_dir>   rewrite the goldens
+ */
+
+#define TEST_SAMPLE_RATE 44100
+#define TEST_BLOCK_SIZE 128
+
+typedef struct {
+    float *samples;
+    int numSamples;
+} Render;
+
+typedef struct {
+    const char *name;
+    // golden file to compare against; scenarios may share one
+    const char *golden;
+    // max absolute error per sample, 0 demands bit-exact output; resonant
+    // filters amplify rounding differences such as FMA contraction
+    float tolerance;
+    Render (*render)(void);
+} Scenario;
+
+/* HELPERS */
+
+static uint32_t rng_state;
+
+static float next_random(void) {
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return (float)(rng_state >> 8) / 16777216.0f * 2.0f - 1.0f;
+}
+
+static AudioNode* add_module(AudioGraph *graph, AudioModuleInterface *interface) {
+    AudioNode *node = create_audio_node(interface);
+    add_node(graph, node);
+    return node;
+}
+
+static AudioNode* add_osc(AudioGraph *graph, float frequency, float gain) {
+    AudioNode *osc = add_module(graph, &SineOscillatorModule);
+    osc->interface->setParameter(osc->instance, OSC_FREQUENCY_PARAM, frequency);
+    osc->interface->setParameter(osc->instance, OSC_GAIN_PARAM, gain);
+    return osc;
+}
+
+static Render create_render(int numBlocks) {
+    Render render;
+    render.numSamples = numBlocks * TEST_BLOCK_SIZE;
+    render.samples = (float*)calloc(render.numSamples, sizeof(float));
+    return render;
+}
+
+static void render_blocks(AudioGraph *graph, AudioNode *out, Render *render, int firstBlock, int numBlocks) {
+    OutputNode *output = (OutputNode*)out->instance;
+    for (int b = firstBlock; b < firstBlock + numBlocks; b++) {
+        process_graph(graph, TEST_BLOCK_SIZE);
+        memcpy(render->samples + b * TEST_BLOCK_SIZE, output->outputs[0], TEST_BLOCK_SIZE * sizeof(float));
+    }
+}
+
+static bool write_test_wav(const char *path, const int16_t *samples, int numFrames) {
+    FILE *file = fopen(path, "wb");
+    if (!file) {return false;}
+
+    const uint32_t dataSize = numFrames * sizeof(int16_t);
+    const uint32_t riffSize = 36 + dataSize;
+    const uint32_t fmtSize = 16;
+    const uint16_t formatTag = 1, channels = 1, blockAlign = 2, bits = 16;
+    const uint32_t sampleRate = TEST_SAMPLE_RATE, byteRate = TEST_SAMPLE_RATE * 2;
+
+    fwrite("RIFF", 1, 4, file);
+    fwrite(&riffSize, 4, 1, file);
+    fwrite("WAVEfmt ", 1, 8, file);
+    fwrite(&fmtSize, 4, 1, file);
+    fwrite(&formatTag, 2, 1, file);
+    fwrite(&channels, 2, 1, file);
+    fwrite(&sampleRate, 4, 1, file);
+    fwrite(&byteRate, 4, 1, file);
+    fwrite(&blockAlign, 2, 1, file);
+    fwrite(&bits, 2, 1, file);
+    fwrite("data", 1, 4, file);
+    fwrite(&dataSize, 4, 1, file);
+    fwrite(samples, sizeof(int16_t), numFrames, file);
+    return fclose(file) == 0;
+}
+
+/* SCENARIOS */
+
+static Render render_sine_osc(void) {
+    AudioGraph *graph = create_audio_graph();
+    AudioNode *osc = add_osc(graph, 440.0f, 0.5f);
+    AudioNode *out = add_module(graph, &OutputNodeModule);
+    connect_nodes(graph, osc, out);
+    init_graph(graph, TEST_SAMPLE_RATE, TEST_BLOCK_SIZE);
+
+    Render render = create_render(64);
+    render_blocks(graph, out, &render, 0, 64);
+    destroy_audio_graph(graph);
+    return render;
+}
+
+static Render render_lowpass_filter(void) {
+    AudioGraph *graph = create_audio_graph();
+    AudioNode *osc = add_osc(graph, 3000.0f, 1.0f);
+    AudioNode *lpf = add_module(graph, &LowPassFilterModule);
+    AudioNode *out = add_module(graph, &OutputNodeModule);
+    lpf->interface->setParameter(lpf->instance, LPF_CUTOF_PARAM, 800.0f);
+    lpf->interface->setParameter(lpf->instance, LPF_Q_PARAM, 2.0f);
+    connect_nodes(graph, osc, lpf);
+    connect_nodes(graph, lpf, out);
+    init_graph(graph, TEST_SAMPLE_RATE, TEST_BLOCK_SIZE);
+
+    Render render = create_render(64);
+    render_blocks(graph, out, &render, 0, 64);
+    destroy_audio_graph(graph);
+    return render;
+}
+
+static Render render_fan_in_mix(void) {
+    AudioGraph *graph = create_audio_graph();
+    AudioNode *osc1 = add_osc(graph, 220.0f, 1.0f);
+    AudioNode *osc2 = add_osc(graph, 261.626f, 1.0f);
+    AudioNode *osc3 = add_osc(graph, 329.628f, 1.0f);
+    AudioNode *lpf = add_module(graph, &LowPassFilterModule);
+    AudioNode *out = add_module(graph, &OutputNodeModule);
+    lpf->interface->setParameter(lpf->instance, LPF_CUTOF_PARAM, 500.0f);
+    connect_nodes(graph, osc1, lpf);
+    connect_nodes(graph, osc2, lpf);
+    connect_nodes(graph, osc3, lpf);
+    connect_nodes(graph, lpf, out);
+    init_graph(graph, TEST_SAMPLE_RATE, TEST_BLOCK_SIZE);
+
+    Render render = create_render(64);
+    render_blocks(graph, out, &render, 0, 64);
+    destroy_audio_graph(graph);
+    return render;
+}
+
+// same graph as fan_in_mix, added sink first; must render identically
+static Render render_out_of_order_nodes(void) {
+    AudioGraph *graph = create_audio_graph();
+    AudioNode *out = add_module(graph, &OutputNodeModule);
+    AudioNode *lpf = add_module(graph, &LowPassFilterModule);
+    AudioNode *osc3 = add_osc(graph, 329.628f, 1.0f);
+    AudioNode *osc1 = add_osc(graph, 220.0f, 1.0f);
+    AudioNode *osc2 = add_osc(graph, 261.626f, 1.0f);
+    lpf->interface->setParameter(lpf->instance, LPF_CUTOF_PARAM, 500.0f);
+    connect_nodes(graph, lpf, out);
+    connect_nodes(graph, osc1, lpf);
+    connect_nodes(graph, osc2, lpf);
+    connect_nodes(graph, osc3, lpf);
+    init_graph(graph, TEST_SAMPLE_RATE, TEST_BLOCK_SIZE);
+
+    Render render = create_render(64);
+    render_blocks(graph, out, &render, 0, 64);
+    destroy_audio_graph(graph);
+    return render;
+}
+
+static Render render_parameter_change(void) {
+    AudioGraph *graph = create_audio_graph();
+    AudioNode *osc = add_osc(graph, 220.0f, 1.0f);
+    AudioNode *lpf = add_module(graph, &LowPassFilterModule);
+    AudioNode *out = add_module(graph, &OutputNodeModule);
+    lpf->interface->setParameter(lpf->instance, LPF_CUTOF_PARAM, 2000.0f);
+    connect_nodes(graph, osc, lpf);
+    connect_nodes(graph, lpf, out);
+    init_graph(graph, TEST_SAMPLE_RATE, TEST_BLOCK_SIZE);
+
+    Render render = create_render(64);
+    render_blocks(graph, out, &render, 0, 16);
+
+    osc->interface->setParameter(osc->instance, OSC_FREQUENCY_PARAM, 164.814f);
+    render_blocks(graph, out, &render, 16, 16);
+
+    lpf->interface->setParameter(lpf->instance, LPF_CUTOF_PARAM, 300.0f);
+    lpf->interface->setParameter(lpf->instance, LPF_Q_PARAM, 4.0f);
+    render_blocks(graph, out, &render, 32, 16);
+
+    osc->interface->setParameter(osc->instance, OSC_GAIN_PARAM, 0.25f);
+    render_blocks(graph, out, &render, 48, 16);
+
+    destroy_audio_graph(graph);
+    return render;
+}
+
+/*
+ * Two filter chains meeting at the output: osc->lpf->lpf and osc->lpf,
+ * which fusion turns into two fused steps plus the output node.
+ */
+static Render render_chain(bool fuse) {
+    Render render = {NULL, 0};
+
+    AudioGraph *graph = create_audio_graph();
+    graph->fuseChains = fuse;
+    AudioNode *osc1 = add_osc(graph, 1500.0f, 1.0f);
+    AudioNode *lpf1 = add_module(graph, &LowPassFilterModule);
+    AudioNode *lpf2 = add_module(graph, &LowPassFilterModule);
+    AudioNode *osc2 = add_osc(graph, 97.0f, 0.5f);
+    AudioNode *lpf3 = add_module(graph, &LowPassFilterModule);
+    AudioNode *out = add_module(graph, &OutputNodeModule);
+    lpf1->interface->setParameter(lpf1->instance, LPF_CUTOF_PARAM, 2500.0f);
+    lpf2->interface->setParameter(lpf2->instance, LPF_CUTOF_PARAM, 1200.0f);
+    lpf2->interface->setParameter(lpf2->instance, LPF_Q_PARAM, 1.5f);
+    lpf3->interface->setParameter(lpf3->instance, LPF_CUTOF_PARAM, 400.0f);
+    connect_nodes(graph, osc1, lpf1);
+    connect_nodes(graph, lpf1, lpf2);
+    connect_nodes(graph, lpf2, out);
+    connect_nodes(graph, osc2, lpf3);
+    connect_nodes(graph, lpf3, out);
+    init_graph(graph, TEST_SAMPLE_RATE, TEST_BLOCK_SIZE);
+
+    if (graph->numSteps != (fuse ? 3 : 6)) {
+        fprintf(stderr, "Expected %d processing steps, got %d\n", fuse ? 3 : 6, graph->numSteps);
+        destroy_audio_graph(graph);
+        return render;
+    }
+
+    render = create_render(64);
+    render_blocks(graph, out, &render, 0, 32);
+    lpf2->interface->setParameter(lpf2->instance, LPF_CUTOF_PARAM, 600.0f);
+    render_blocks(graph, out, &render, 32, 32);
+
+    destroy_audio_graph(graph);
+    return render;
+}
+
+static Render render_fused_chain(void) {
+    return render_chain(true);
+}
+
+// same graph with fusion off; must match the fused render
+static Render render_unfused_chain(void) {
+    return render_chain(false);
+}
+
+// an LFO at control rate next to an audio tone; the period divides the rate but not the block
+static Render render_control_rate_lfo(void) {
+    AudioGraph *graph = create_audio_graph();
+    graph->controlPeriod = 45;
+    AudioNode *osc = add_osc(graph, 220.0f, 1.0f);
+    AudioNode *lfo = add_osc(graph, 8.0f, 1.0f);
+    AudioNode *out = add_module(graph, &OutputNodeModule);
+    lfo->rate = MODULE_RATE_CONTROL;
+    connect_nodes(graph, osc, out);
+    connect_nodes(graph, lfo, out);
+    // 45 does not divide 48000, but the requested period must survive for the next init
+    init_graph(graph, 48000, TEST_BLOCK_SIZE);
+    const bool lowered = graph->effectiveControlPeriod == 40;
+    init_graph(graph, TEST_SAMPLE_RATE, TEST_BLOCK_SIZE);
+    const bool restored = graph->controlPeriod == 45 && graph->effectiveControlPeriod == 45;
+
+    Render render = create_render(64);
+    render_blocks(graph, out, &render, 0, 32);
+    set_node_parameter(lfo, OSC_FREQUENCY_PARAM, 3.0f);
+    render_blocks(graph, out, &render, 32, 32);
+
+    if (!lowered || !restored) {
+        fprintf(stderr, "control period not kept across init at another rate\n");
+        free(render.samples);
+        render.samples = NULL;
+    }
+    destroy_audio_graph(graph);
+    return render;
+}
+
+// a period longer than the block, so the second change cuts the first ramp short
+static Render render_event_value(void) {
+    AudioGraph *graph = create_audio_graph();
+    graph->controlPeriod = 196;
+    AudioNode *osc = add_osc(graph, 330.0f, 0.5f);
+    AudioNode *value = add_module(graph, &ValueModule);
+    AudioNode *out = add_module(graph, &OutputNodeModule);
+    connect_nodes(graph, osc, out);
+    connect_nodes(graph, value, out);
+    set_node_parameter(value, VALUE_PARAM, 0.25f);
+    init_graph(graph, TEST_SAMPLE_RATE, TEST_BLOCK_SIZE);
+
+    Render render = create_render(48);
+    render_blocks(graph, out, &render, 0, 8);
+    set_node_parameter(value, VALUE_PARAM, 0.5f);
+    render_blocks(graph, out, &render, 8, 1);
+    set_node_parameter(value, VALUE_PARAM, -0.25f);
+    render_blocks(graph, out, &render, 9, 21);
+    set_node_parameter(value, VALUE_PARAM, 0.0f);
+    render_blocks(graph, out, &render, 30, 18);
+
+    destroy_audio_graph(graph);
+    return render;
+}
+
+// tail partitions run inline, so the render does not depend on worker timing
+static Render render_convolution(int irLength, int numBlocks) {
+    float *ir = (float*)malloc(irLength * sizeof(float));
+    rng_state = 1;
+    for (int i = 0; i < irLength; i++) {
+        ir[i] = next_random() * expf(-(float)i / (irLength / 4)) * 0.05f;
+    }
+
+    AudioGraph *graph = create_audio_graph();
+    AudioNode *osc = add_osc(graph, 330.0f, 1.0f);
+    AudioNode *reverb = add_module(graph, &ConvolutionReverbModule);
+    AudioNode *out = add_module(graph, &OutputNodeModule);
+    ConvolutionReverb *state = (ConvolutionReverb*)reverb->instance;
+    convolution_reverb_set_ir(state, ir, irLength, TEST_SAMPLE_RATE);
+    convolution_reverb_set_offline(state, true);
+    reverb->interface->setParameter(reverb->instance, CONV_DRY_PARAM, 0.5f);
+    connect_nodes(graph, osc, reverb);
+    connect_nodes(graph, reverb, out);
+    init_graph(graph, TEST_SAMPLE_RATE, TEST_BLOCK_SIZE);
+
+    // silence the source halfway so the decaying tail is covered too
+    Render render = create_render(numBlocks);
+    render_blocks(graph, out, &render, 0, numBlocks / 2);
+    osc->interface->setParameter(osc->instance, OSC_GAIN_PARAM, 0.0f);
+    render_blocks(graph, out, &render, numBlocks / 2, numBlocks - numBlocks / 2);
+
+    destroy_audio_graph(graph);
+    free(ir);
+    return render;
+}
+
+static Render render_convolution_short(void) {
+    return render_convolution(1000, 64);
+}
+
+// long enough to engage the background tail partitions
+static Render render_convolution_long(void) {
+    return render_convolution(20000, 384);
+}
+
+static Render render_sampler(void) {
+    Render render = {NULL, 0};
+
+    // shorter than SAMPLER_PRELOAD_FRAMES so playback never depends on streaming timing
+    const int numFrames = 20000;
+    int16_t *pcm = (int16_t*)malloc(numFrames * sizeof(int16_t));
+    for (int i = 0; i < numFrames; i++) {
+        const float v = sinf(2.0f * (float)M_PI * 110.0f * i / TEST_SAMPLE_RATE) * expf(-(float)i / 8000.0f);
+        pcm[i] = (int16_t)lrintf(v * 30000.0f);
+    }
+
+    char path[] = "/tmp/keiko_golden_XXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0) {
+        free(pcm);
+        return render;
+    }
+    close(fd);
+    const bool written = write_test_wav(path, pcm, numFrames);
+    free(pcm);
+
+    AudioGraph *graph = create_audio_graph();
+    AudioNode *sampler = add_module(graph, &SamplerModule);
+    AudioNode *out = add_module(graph, &OutputNodeModule);
+    if (!written || !sampler_load((Sampler*)sampler->instance, path)) {
+        destroy_audio_graph(graph);
+        unlink(path);
+        return render;
+    }
+    unlink(path);
+
+    sampler->interface->setParameter(sampler->instance, SAMPLER_GAIN_PARAM, 0.8f);
+    connect_nodes(graph, sampler, out);
+    init_graph(graph, TEST_SAMPLE_RATE, TEST_BLOCK_SIZE);
+
+    render = create_render(192);
+    render_blocks(graph, out, &render, 0, 8);
+    sampler->interface->setParameter(sampler->instance, SAMPLER_TRIGGER_PARAM, 1.0f);
+    render_blocks(graph, out, &render, 8, 184);
+
+    destroy_audio_graph(graph);
+    return render;
+}
+
+// the first block of an oscillator alone at frequency, for comparing against a routed one
+static bool matches_plain_osc(const float *samples, float frequency, float gain) {
+    AudioGraph *graph = create_audio_graph();
+    AudioNode *osc = add_osc(graph, frequency, gain);
+    init_graph(graph, TEST_SAMPLE_RATE, TEST_BLOCK_SIZE);
+    process_graph(graph, TEST_BLOCK_SIZE);
+    const bool same = memcmp(osc->outputBuffer, samples, TEST_BLOCK_SIZE * sizeof(float)) == 0;
+    destroy_audio_graph(graph);
+    return same;
+}
+
+/*
+ * Nothing is mixed into the tones: a control rate LFO drives an event
+ * value that sets one tone's gain, and a second value sets both tones'
+ * frequency and is changed halfway. The steady tone has to be at its
+ * routed frequency from the very first sample, not glide up from 0 Hz.
+ */
+static Render render_parameter_routing(void) {
+    AudioGraph *graph = create_audio_graph();
+    graph->controlPeriod = 45;
+    AudioNode *osc = add_osc(graph, 0.0f, 0.0f);
+    AudioNode *tone = add_osc(graph, 0.0f, 0.25f);
+    AudioNode *lfo = add_osc(graph, 6.0f, 0.8f);
+    AudioNode *gain = add_module(graph, &ValueModule);
+    AudioNode *frequency = add_module(graph, &ValueModule);
+    AudioNode *out = add_module(graph, &OutputNodeModule);
+    lfo->rate = MODULE_RATE_CONTROL;
+    connect_parameter(graph, lfo, gain, VALUE_PARAM);
+    connect_parameter(graph, gain, osc, OSC_GAIN_PARAM);
+    connect_parameter(graph, frequency, osc, OSC_FREQUENCY_PARAM);
+    connect_parameter(graph, frequency, tone, OSC_FREQUENCY_PARAM);
+    connect_nodes(graph, osc, out);
+    connect_nodes(graph, tone, out);
+    set_node_parameter(frequency, VALUE_PARAM, 440.0f);
+    init_graph(graph, TEST_SAMPLE_RATE, TEST_BLOCK_SIZE);
+
+    Render render = create_render(64);
+    render_blocks(graph, out, &render, 0, 1);
+    const bool startsSettled = matches_plain_osc(tone->outputBuffer, 440.0f, 0.25f);
+    render_blocks(graph, out, &render, 1, 31);
+    set_node_parameter(frequency, VALUE_PARAM, 660.0f);
+    render_blocks(graph, out, &render, 32, 32);
+
+    if (!startsSettled) {
+        fprintf(stderr, "routed frequency did not start at 440 Hz\n");
+        free(render.samples);
+        render.samples = NULL;
+    }
+    destroy_audio_graph(graph);
+    return render;
+}
+
+static const Scenario scenarios[] = {
+    {"sine_osc", "sine_osc", 1e-5f, render_sine_osc},
+    {"lowpass_filter", "lowpass_filter", 1e-4f, render_lowpass_filter},
+    {"fan_in_mix", "fan_in_mix", 1e-4f, render_fan_in_mix},
+    {"parameter_change", "parameter_change", 1e-4f, render_parameter_change},
+    {"out_of_order_nodes", "fan_in_mix", 1e-4f, render_out_of_order_nodes},
+    {"fused_chain", "fused_chain", 1e-4f, render_fused_chain},
+    {"unfused_chain", "fused_chain", 1e-4f, render_unfused_chain},
+    {"control_rate_lfo", "control_rate_lfo", 1e-5f, render_control_rate_lfo},
+    {"event_value", "event_value", 1e-5f, render_event_value},
+    {"parameter_routing", "parameter_routing", 1e-5f, render_parameter_routing},
+    {"convolution_short", "convolution_short", 1e-4f, render_convolution_short},
+    {"convolution_long", "convolution_long", 1e-4f, render_convolution_long},
+    {"sampler", "sampler", 0.0f, render_sampler},
+};
+
+#define NUM_SCENARIOS ((int)(sizeof(scenarios) / sizeof(scenarios[0])))
+
+/* GOLDEN FILES */
+
+static void golden_path(char *path, size_t size, const char *dir, const char *name) {
+    snprintf(path, size, "%s/%s.f32", dir, name);
+}
+
+// goldens are little-endian whatever the host's byte order
+static void float_to_le(float value, unsigned char *bytes) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    for (int b = 0; b < 4; b++) {
+        bytes[b] = (unsigned char)(bits >> (8 * b));
+    }
+}
+
+static float float_from_le(const unsigned char *bytes) {
+    const uint32_t bits = (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 |
+                          (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static bool write_golden(const char *dir, const Scenario *scenario, const Render *render) {
+    char path[1024];
+    golden_path(path, sizeof(path), dir, scenario->golden);
+
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s for writing\n", path);
+        return false;
+    }
+    unsigned char *bytes = (unsigned char*)malloc((size_t)render->numSamples * 4 + 1);
+    for (int i = 0; i < render->numSamples; i++) {
+        float_to_le(render->samples[i], bytes + 4 * i);
+    }
+    const size_t written = fwrite(bytes, 4, render->numSamples, file);
+    fclose(file);
+    free(bytes);
+
+    printf("wrote %s (%d samples)\n", path, render->numSamples);
+    return written == (size_t)render->numSamples;
+}
+
+static bool compare_golden(const char *dir, const Scenario *scenario, const Render *render) {
+    char path[1024];
+    golden_path(path, sizeof(path), dir, scenario->golden);
+
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "FAIL %s: missing golden file %s\n", scenario->name, path);
+        return false;
+    }
+    unsigned char *bytes = (unsigned char*)malloc(((size_t)render->numSamples + 1) * 4);
+    const size_t count = fread(bytes, 4, render->numSamples + 1, file);
+    fclose(file);
+
+    if (count != (size_t)render->numSamples) {
+        fprintf(stderr, "FAIL %s: golden has %zu samples, render has %d\n",
+                scenario->name, count, render->numSamples);
+        free(bytes);
+        return false;
+    }
+    float *golden = (float*)malloc(((size_t)render->numSamples + 1) * sizeof(float));
+    for (int i = 0; i < render->numSamples; i++) {
+        golden[i] = float_from_le(bytes + 4 * i);
+    }
+    free(bytes);
+
+    float maxError = 0.0f;
+    int failures = 0;
+    for (int i = 0; i < render->numSamples; i++) {
+        const float got = render->samples[i];
+        const float error = fabsf(got - golden[i]);
+
+        if (!isfinite(got) || error > scenario->tolerance) {
+            if (failures++ == 0) {
+                fprintf(stderr, "FAIL %s: sample %d expected %.9g got %.9g\n",
+                        scenario->name, i, golden[i], got);
+            }
+        }
+        if (error > maxError) {maxError = error;}
+    }
+    free(golden);
+
+    if (failures > 0) {
+        fprintf(stderr, "FAIL %s: %d samples outside tolerance %g, max error %g\n",
+                scenario->name, failures, scenario->tolerance, maxError);
+        return false;
+    }
+    printf("PASS %s (max error %g)\n", scenario->name, maxError);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    bool update = false;
+    int arg = 1;
+    if (arg < argc && strcmp(argv[arg], "--update") == 0) {
+        update = true;
+        arg++;
+    }
+    if (argc - arg != 2) {
+        fprintf(stderr, "usage: %s [--update] <scenario|all> <golden_dir>\n", argv[0]);
+        return 2;
+    }
+    const char *selected = argv[arg];
+    const char *dir = argv[arg + 1];
+
+    int ran = 0;
+    bool ok = true;
+    for (int i = 0; i < NUM_SCENARIOS; i++) {
+        const Scenario *scenario = &scenarios[i];
+        if (strcmp(selected, "all") != 0 && strcmp(selected, scenario->name) != 0) {continue;}
+        ran++;
+
+        Render render = scenario->render();
+        if (!render.samples) {
+            fprintf(stderr, "FAIL %s: render failed\n", scenario->name);
+            ok = false;
+            continue;
+        }
+
+        // shared goldens are owned by the scenario of the same name
+        if (update && strcmp(scenario->name, scenario->golden) == 0) {
+            ok = write_golden(dir, scenario, &render) && ok;
+        } else if (!update) {
+            ok = compare_golden(dir, scenario, &render) && ok;
+        }
+        free(render.samples);
+    }
+
+    if (ran == 0) {
+        fprintf(stderr, "Unknown scenario %s\n", selected);
+        return 2;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,258 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "audio_graph.h"
+#include "graph_host.h"
+#include "sine_osc_module.h"
+#include "lowpass_filter_module.h"
+#include "output_module.h"
+#include "ring_buffer.h"
+
+/*
+ * Runs several independent sessions on a small worker pool and checks
+ * that each one renders exactly what it renders on its own, and that
+ * the scheduler keeps the sessions level with each other. Then feeds a
+ * consumer slower than real time and checks that back-pressure holds
+ * blocks instead of losing them, and finally destroys a host that still
+ * has a session rendering.
+ */
+
+#define TEST_SAMPLE_RATE 44100
+#define TEST_BLOCK_SIZE 128
+#define NUM_SESSIONS 8
+#define NUM_WORKERS 3
+#define LATENCY_BLOCKS 2
+#define TARGET_BLOCKS 64
+#define TIMEOUT_MS 10000
+
+typedef struct {
+    AudioGraph *graph;
+    AudioNode *out;
+    float samples[TARGET_BLOCKS * TEST_BLOCK_SIZE];
+    int blocks;
+    pthread_mutex_t lock;
+} TestSession;
+
+static void build_graph(TestSession *test, int index) {
+    test->graph = create_audio_graph();
+
+    AudioNode *osc = create_audio_node(&SineOscillatorModule);
+    AudioNode *lpf = create_audio_node(&LowPassFilterModule);
+    test->out = create_audio_node(&OutputNodeModule);
+    add_node(test->graph, osc);
+    add_node(test->graph, lpf);
+    add_node(test->graph, test->out);
+
+    osc->interface->setParameter(osc->instance, OSC_FREQUENCY_PARAM, 110.0f * (index + 1));
+    lpf->interface->setParameter(lpf->instance, LPF_CUTOF_PARAM, 300.0f + 150.0f * index);
+    connect_nodes(test->graph, osc, lpf);
+    connect_nodes(test->graph, lpf, test->out);
+    init_graph(test->graph, TEST_SAMPLE_RATE, TEST_BLOCK_SIZE);
+}
+
+static bool collect_sink(void *userData, const float *samples, int numSamples) {
+    TestSession *test = (TestSession*)userData;
+    pthread_mutex_lock(&test->lock);
+    if (test->blocks < TARGET_BLOCKS) {
+        memcpy(test->samples + test->blocks * TEST_BLOCK_SIZE, samples, numSamples * sizeof(float));
+        test->blocks++;
+    }
+    pthread_mutex_unlock(&test->lock);
+    return true;
+}
+
+static bool ring_sink(void *userData, const float *samples, int numSamples) {
+    return ring_buffer_write((RingBuffer*)userData, samples, numSamples);
+}
+
+/*
+ * A device whose clock runs a quarter slower than the host's drains a
+ * small ring one block at a time. Every block must arrive exactly once
+ * and in order, with the host stalling on the full ring along the way.
+ */
+static bool test_back_pressure(void) {
+    TestSession test;
+    build_graph(&test, 0);
+    RingBuffer *ring = create_ring_buffer(4 * TEST_BLOCK_SIZE, 1);
+    GraphHost *host = create_graph_host(1);
+    GraphSession *session = add_graph_session(host, test.graph, test.out, TEST_SAMPLE_RATE,
+                                              TEST_BLOCK_SIZE, LATENCY_BLOCKS, ring_sink, ring);
+
+    TestSession reference;
+    build_graph(&reference, 0);
+    OutputNode *output = (OutputNode*)reference.out->instance;
+
+    const long periodNs = (long)TEST_BLOCK_SIZE * 1000000000L / TEST_SAMPLE_RATE * 5 / 4;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    float block[TEST_BLOCK_SIZE];
+    bool ok = true;
+    for (int b = 0; b < TARGET_BLOCKS && ok; b++) {
+        next.tv_nsec += periodNs;
+        if (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+        // a late worker is tolerated, a lost or repeated block is not
+        for (int waited = 0; !ring_buffer_read(ring, block, TEST_BLOCK_SIZE); waited++) {
+            if (waited == TIMEOUT_MS) {
+                fprintf(stderr, "FAIL back-pressure session stopped delivering at block %d\n", b);
+                ok = false;
+                break;
+            }
+            usleep(1000);
+        }
+        if (!ok) {break;}
+
+        process_graph(reference.graph, TEST_BLOCK_SIZE);
+        if (memcmp(output->outputs[0], block, sizeof(block)) != 0) {
+            fprintf(stderr, "FAIL back-pressure session lost or repeated a block before block %d\n", b);
+            ok = false;
+        }
+    }
+
+    pthread_mutex_lock(&host->lock);
+    const uint64_t stalls = session->sinkStalls;
+    pthread_mutex_unlock(&host->lock);
+    if (ok && stalls == 0) {
+        fprintf(stderr, "FAIL slow consumer never pushed back\n");
+        ok = false;
+    }
+
+    remove_graph_session(host, session);
+    destroy_graph_host(host);
+    destroy_ring_buffer(ring);
+    destroy_audio_graph(reference.graph);
+    destroy_audio_graph(test.graph);
+
+    if (ok) {printf("PASS back-pressure (%llu stalls)\n", (unsigned long long)stalls);}
+    return ok;
+}
+
+// the host frees the session itself; run under ASan this catches a double free or a leak
+static bool test_destroy_with_session(void) {
+    TestSession test;
+    test.blocks = 0;
+    pthread_mutex_init(&test.lock, NULL);
+    build_graph(&test, 1);
+    GraphHost *host = create_graph_host(2);
+    GraphSession *session = add_graph_session(host, test.graph, test.out, TEST_SAMPLE_RATE,
+                                              TEST_BLOCK_SIZE, LATENCY_BLOCKS, collect_sink, &test);
+    if (!host || !session) {
+        fprintf(stderr, "FAIL could not start a session to destroy\n");
+        return false;
+    }
+
+    bool ok = false;
+    for (int waited = 0; waited < TIMEOUT_MS && !ok; waited += 10) {
+        usleep(10000);
+        pthread_mutex_lock(&test.lock);
+        ok = test.blocks > 0;
+        pthread_mutex_unlock(&test.lock);
+    }
+    destroy_graph_host(host);
+    destroy_audio_graph(test.graph);
+    pthread_mutex_destroy(&test.lock);
+
+    if (!ok) {fprintf(stderr, "FAIL session to destroy never rendered\n");}
+    return ok;
+}
+
+static int blocks_collected(TestSession *test) {
+    pthread_mutex_lock(&test->lock);
+    const int blocks = test->blocks;
+    pthread_mutex_unlock(&test->lock);
+    return blocks;
+}
+
+int main(void) {
+    static TestSession tests[NUM_SESSIONS];
+    GraphSession *sessions[NUM_SESSIONS];
+    bool ok = true;
+
+    GraphHost *host = create_graph_host(NUM_WORKERS);
+    if (!host) {return 1;}
+
+    for (int i = 0; i < NUM_SESSIONS; i++) {
+        pthread_mutex_init(&tests[i].lock, NULL);
+        build_graph(&tests[i], i);
+        sessions[i] = add_graph_session(host, tests[i].graph, tests[i].out, TEST_SAMPLE_RATE,
+                                        TEST_BLOCK_SIZE, LATENCY_BLOCKS, collect_sink, &tests[i]);
+    }
+
+    // sample the spread once the schedule has settled
+    usleep(100000);
+    pthread_mutex_lock(&host->lock);
+    uint64_t fewest = UINT64_MAX, most = 0;
+    for (int i = 0; i < NUM_SESSIONS; i++) {
+        if (sessions[i]->blocksRendered < fewest) {fewest = sessions[i]->blocksRendered;}
+        if (sessions[i]->blocksRendered > most) {most = sessions[i]->blocksRendered;}
+    }
+    pthread_mutex_unlock(&host->lock);
+    if (most - fewest > NUM_WORKERS + LATENCY_BLOCKS) {
+        fprintf(stderr, "FAIL sessions drifted apart: %llu vs %llu blocks\n",
+                (unsigned long long)fewest, (unsigned long long)most);
+        ok = false;
+    }
+
+    for (int waited = 0; waited < TIMEOUT_MS; waited += 10) {
+        bool done = true;
+        for (int i = 0; i < NUM_SESSIONS; i++) {
+            done = done && blocks_collected(&tests[i]) == TARGET_BLOCKS;
+        }
+        if (done) {break;}
+        usleep(10000);
+    }
+
+    uint64_t misses = 0;
+    pthread_mutex_lock(&host->lock);
+    for (int i = 0; i < NUM_SESSIONS; i++) {
+        misses += sessions[i]->deadlineMisses;
+    }
+    pthread_mutex_unlock(&host->lock);
+
+    for (int i = 0; i < NUM_SESSIONS; i++) {
+        remove_graph_session(host, sessions[i]);
+    }
+    destroy_graph_host(host);
+
+    for (int i = 0; i < NUM_SESSIONS; i++) {
+        TestSession *test = &tests[i];
+        if (test->blocks != TARGET_BLOCKS) {
+            fprintf(stderr, "FAIL session %d rendered %d of %d blocks\n", i, test->blocks, TARGET_BLOCKS);
+            ok = false;
+            continue;
+        }
+
+        // render the same graph again on this thread and expect identical output
+        TestSession reference;
+        build_graph(&reference, i);
+        OutputNode *output = (OutputNode*)reference.out->instance;
+        for (int b = 0; b < TARGET_BLOCKS; b++) {
+            process_graph(reference.graph, TEST_BLOCK_SIZE);
+            if (memcmp(output->outputs[0], test->samples + b * TEST_BLOCK_SIZE,
+                       TEST_BLOCK_SIZE * sizeof(float)) != 0) {
+                fprintf(stderr, "FAIL session %d differs from reference in block %d\n", i, b);
+                ok = false;
+                break;
+            }
+        }
+        destroy_audio_graph(reference.graph);
+        destroy_audio_graph(test->graph);
+        pthread_mutex_destroy(&test->lock);
+    }
+
+    ok = test_back_pressure() && ok;
+    ok = test_destroy_with_session() && ok;
+
+    if (!ok) {return 1;}
+    printf("PASS %d sessions on %d workers (%llu deadline misses)\n",
+           NUM_SESSIONS, NUM_WORKERS, (unsigned long long)misses);
+    return 0;
+}
@@ -0,0 +1,206 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "audio_graph.h"
+#include "resampler.h"
+#include "sine_osc_module.h"
+#include "output_module.h"
+#include "subgraph_module.h"
+
+/*
+ * Converts sine tones between rates in random chunk sizes and compares
+ * them with the analytic tone at the output rate, checks that tones above
+ * the output Nyquist are rejected and that the pull API is exact, then
+ * renders subgraphs running at a lower rate.
+ */
+
+#define TEST_SAMPLE_RATE 44100
+#define TEST_BLOCK_SIZE 128
+#define MAX_CHUNK 700
+
+static uint32_t rng_state = 1;
+
+static int random_chunk(void) {
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return 1 + (int)((rng_state >> 8) % MAX_CHUNK);
+}
+
+// resamples a tone and returns the worst error against the ideal, or the RMS if rejected
+static float convert_tone(int inputRate, int outputRate, float frequency, bool rejected) {
+    Resampler *resampler = create_resampler(inputRate, outputRate);
+    if (!resampler) {return INFINITY;}
+
+    const int numInput = inputRate / 2;
+    float *input = (float*)malloc(numInput * sizeof(float));
+    float *output = (float*)malloc((numInput * (double)outputRate / inputRate + 2) * sizeof(float));
+    for (int i = 0; i < numInput; i++) {
+        input[i] = (float)sin(2.0 * M_PI * frequency * i / inputRate);
+    }
+
+    int consumed = 0, produced = 0;
+    while (consumed < numInput) {
+        int count = random_chunk();
+        if (count > numInput - consumed) {count = numInput - consumed;}
+        produced += resampler_process(resampler, input + consumed, count, output + produced,
+                                      resampler_max_output(resampler, count));
+        consumed += count;
+    }
+
+    // output j lines up with input time j * inputRate / outputRate - numTaps / 2
+    const double delay = (double)(resampler->numTaps / 2) / inputRate;
+    const int settle = 2 * resampler_latency(resampler);
+    double worst = 0.0, energy = 0.0;
+    for (int j = settle; j < produced; j++) {
+        if (rejected) {
+            energy += output[j] * output[j];
+        } else {
+            const double expected = sin(2.0 * M_PI * frequency * ((double)j / outputRate - delay));
+            const double error = fabs(output[j] - expected);
+            if (error > worst) {worst = error;}
+        }
+    }
+
+    free(input);
+    free(output);
+    destroy_resampler(resampler);
+    return rejected ? (float)sqrt(energy / (produced - settle)) : (float)worst;
+}
+
+static bool test_tones(void) {
+    const struct {int inputRate, outputRate; float frequency;} cases[] = {
+        {44100, 48000, 1000.0f},
+        {48000, 44100, 1000.0f},
+        {44100, 96000, 5000.0f},
+        {44100, 44101, 3000.0f},   // 44101 is prime, so phases are interpolated
+        {44100, 11025, 500.0f},
+        {44100, 1378, 40.0f},
+    };
+    bool ok = true;
+
+    for (int i = 0; i < (int)(sizeof(cases) / sizeof(cases[0])); i++) {
+        const float error = convert_tone(cases[i].inputRate, cases[i].outputRate, cases[i].frequency, false);
+        if (!(error < 1e-3f)) {
+            fprintf(stderr, "FAIL %d -> %d Hz: %g Hz tone off by %g\n",
+                    cases[i].inputRate, cases[i].outputRate, cases[i].frequency, error);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+static bool test_alias_rejection(void) {
+    // 6 kHz does not fit below the 4 kHz Nyquist of the output
+    const float rms = convert_tone(48000, 8000, 6000.0f, true);
+    if (!(rms < 1e-3f)) {
+        fprintf(stderr, "FAIL tone above the output Nyquist leaks through at rms %g\n", rms);
+        return false;
+    }
+    return true;
+}
+
+static bool test_pull(void) {
+    const int rates[][2] = {{11025, 44100}, {44100, 8000}, {44100, 44101}, {48000, 44100}};
+    // enough input for a full chunk at the strongest decimation below
+    float input[6 * MAX_CHUNK];
+    float output[MAX_CHUNK];
+    memset(input, 0, sizeof(input));
+
+    for (int r = 0; r < 4; r++) {
+        Resampler *resampler = create_resampler(rates[r][0], rates[r][1]);
+        for (int i = 0; i < 1000; i++) {
+            const int wanted = random_chunk();
+            const int needed = resampler_input_needed(resampler, wanted);
+            const int produced = resampler_process(resampler, input, needed, output, wanted);
+            if (produced != wanted) {
+                fprintf(stderr, "FAIL %d -> %d Hz: pulled %d samples, got %d\n",
+                        rates[r][0], rates[r][1], wanted, produced);
+                destroy_resampler(resampler);
+                return false;
+            }
+        }
+        destroy_resampler(resampler);
+    }
+    return true;
+}
+
+/*
+ * An outer oscillator runs through a subgraph at internalRate that only
+ * passes its input on, or the subgraph generates the tone itself; either
+ * way the output is the tone delayed by the resampling filters.
+ */
+static bool test_subgraph(int internalRate, bool throughInput) {
+    const float frequency = 300.0f;
+
+    AudioGraph *graph = create_audio_graph();
+    AudioNode *osc = create_audio_node(&SineOscillatorModule);
+    AudioNode *sub = create_audio_node(&SubgraphModule);
+    AudioNode *out = create_audio_node(&OutputNodeModule);
+    add_node(graph, osc);
+    add_node(graph, sub);
+    add_node(graph, out);
+    connect_nodes(graph, osc, sub);
+    connect_nodes(graph, sub, out);
+
+    Subgraph *subgraph = (Subgraph*)sub->instance;
+    AudioNode *innerOut = create_audio_node(&OutputNodeModule);
+    add_node(subgraph->graph, innerOut);
+    if (throughInput) {
+        osc->interface->setParameter(osc->instance, OSC_FREQUENCY_PARAM, frequency);
+        osc->interface->setParameter(osc->instance, OSC_GAIN_PARAM, 1.0f);
+        connect_nodes(subgraph->graph, subgraph->input, innerOut);
+    } else {
+        osc->interface->setParameter(osc->instance, OSC_GAIN_PARAM, 0.0f);
+        AudioNode *innerOsc = create_audio_node(&SineOscillatorModule);
+        add_node(subgraph->graph, innerOsc);
+        innerOsc->interface->setParameter(innerOsc->instance, OSC_FREQUENCY_PARAM, frequency);
+        innerOsc->interface->setParameter(innerOsc->instance, OSC_GAIN_PARAM, 1.0f);
+        connect_nodes(subgraph->graph, innerOsc, innerOut);
+    }
+    subgraph_set_output(subgraph, innerOut);
+    subgraph_set_sample_rate(subgraph, internalRate);
+    init_graph(graph, TEST_SAMPLE_RATE, TEST_BLOCK_SIZE);
+
+    // getLatency rounds, so use the exact filter delays; an inner tone
+    // starts at inner time zero and is only delayed by the upsampler
+    double delay = (double)(subgraph->up->numTaps / 2) / internalRate;
+    if (throughInput) {delay += (double)(subgraph->down->numTaps / 2) / TEST_SAMPLE_RATE;}
+    const int settle = 2 * sub->interface->getLatency(sub->instance);
+
+    OutputNode *output = (OutputNode*)out->instance;
+    double worst = 0.0;
+    for (int b = 0; b < 128; b++) {
+        process_graph(graph, TEST_BLOCK_SIZE);
+        for (int i = 0; i < TEST_BLOCK_SIZE; i++) {
+            const int n = b * TEST_BLOCK_SIZE + i;
+            if (n < settle) {continue;}
+            const double expected = sin(2.0 * M_PI * frequency * ((double)n / TEST_SAMPLE_RATE - delay));
+            const double error = fabs(output->outputs[0][i] - expected);
+            if (error > worst) {worst = error;}
+        }
+    }
+    destroy_audio_graph(graph);
+
+    if (!(worst < 2e-3)) {
+        fprintf(stderr, "FAIL subgraph at %d Hz (%s) off by %g\n",
+                internalRate, throughInput ? "input" : "generated", worst);
+        return false;
+    }
+    return true;
+}
+
+int main(void) {
+    bool ok = true;
+    ok = test_tones() && ok;
+    ok = test_alias_rejection() && ok;
+    ok = test_pull() && ok;
+    ok = test_subgraph(11025, false) && ok;
+    ok = test_subgraph(22050, true) && ok;
+    ok = test_subgraph(16000, true) && ok;
+
+    if (!ok) {return 1;}
+    printf("PASS resampler\n");
+    return 0;
+}
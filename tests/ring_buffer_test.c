@@ -0,0 +1,192 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ring_buffer.h"
+
+/*
+ * Single-threaded checks of capacity and wrap-around, then a stress run
+ * where a producer and a consumer thread move a numbered frame sequence
+ * through a small buffer in random chunk sizes, alternating between the
+ * copying and the zero-copy region APIs.
+ */
+
+#define STRESS_CHANNELS 2
+#define STRESS_CAPACITY 1000
+#define STRESS_FRAMES 4000000
+#define MAX_CHUNK 300
+
+typedef struct {
+    RingBuffer *rb;
+    uint32_t seed;
+    bool ok;
+} StressThread;
+
+static bool fail(const char *message) {
+    fprintf(stderr, "FAIL %s\n", message);
+    return false;
+}
+
+static int random_chunk(uint32_t *seed) {
+    *seed = *seed * 1664525u + 1013904223u;
+    return 1 + (int)((*seed >> 8) % MAX_CHUNK);
+}
+
+static bool test_capacity(void) {
+    RingBuffer *rb = create_ring_buffer(1000, 2);
+    if (!rb) {return fail("create_ring_buffer");}
+
+    bool ok = true;
+    if (rb->capacity != 1024) {ok = fail("capacity is not rounded to a power of two");}
+    if (ring_buffer_write_available(rb) != 1024) {ok = fail("empty buffer does not offer every slot");}
+
+    float frames[1024 * 2];
+    for (int i = 0; i < 1024 * 2; i++) {frames[i] = (float)i;}
+    if (!ring_buffer_write(rb, frames, 1024)) {ok = fail("cannot fill every slot");}
+    if (ring_buffer_write(rb, frames, 1)) {ok = fail("write into a full buffer succeeded");}
+    if (ring_buffer_read_available(rb) != 1024) {ok = fail("full buffer does not report every frame");}
+
+    float out[1024 * 2];
+    if (!ring_buffer_read(rb, out, 1024) || memcmp(out, frames, sizeof(frames)) != 0) {
+        ok = fail("full buffer reads back wrong");
+    }
+    if (ring_buffer_read(rb, out, 1)) {ok = fail("read from an empty buffer succeeded");}
+
+    destroy_ring_buffer(rb);
+    return ok;
+}
+
+static bool test_wrapping_region(void) {
+    RingBuffer *rb = create_ring_buffer(8, 1);
+    float frames[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+    bool ok = true;
+
+    ring_buffer_write(rb, frames, 6);
+    float out[8];
+    ring_buffer_read(rb, out, 6);
+
+    RingBufferRegion region;
+    if (ring_buffer_acquire_write(rb, 5, &region) != 5) {ok = fail("acquire_write granted too little");}
+    if (region.frames[0] != 2 || region.frames[1] != 3) {ok = fail("write region does not split at the end");}
+    if (region.data[1] != rb->buffer) {ok = fail("second span does not start at the buffer");}
+    memcpy(region.data[0], frames, 2 * sizeof(float));
+    memcpy(region.data[1], frames + 2, 3 * sizeof(float));
+    ring_buffer_commit_write(rb, 5);
+
+    if (ring_buffer_acquire_write(rb, 8, &region) != 3) {ok = fail("acquire_write ignores the free space");}
+
+    if (ring_buffer_acquire_read(rb, 8, &region) != 5) {ok = fail("acquire_read ignores the fill level");}
+    if (region.frames[0] != 2 || region.frames[1] != 3 ||
+        region.data[0][0] != 0.0f || region.data[1][2] != 4.0f) {
+        ok = fail("read region does not match what was written");
+    }
+    ring_buffer_commit_read(rb, 5);
+    if (ring_buffer_read_available(rb) != 0) {ok = fail("commit_read left frames behind");}
+
+    destroy_ring_buffer(rb);
+    return ok;
+}
+
+static void* stress_producer(void *args) {
+    StressThread *thread = (StressThread*)args;
+    RingBuffer *rb = thread->rb;
+    float chunk[MAX_CHUNK * STRESS_CHANNELS];
+    int next = 0;
+    bool useRegion = false;
+
+    while (next < STRESS_FRAMES) {
+        int count = random_chunk(&thread->seed);
+        if (count > STRESS_FRAMES - next) {count = STRESS_FRAMES - next;}
+
+        if (useRegion) {
+            RingBufferRegion region;
+            const int granted = ring_buffer_acquire_write(rb, count, &region);
+            int frame = next;
+            for (int s = 0; s < 2; s++) {
+                for (int i = 0; i < region.frames[s]; i++, frame++) {
+                    region.data[s][i * STRESS_CHANNELS] = (float)frame;
+                    region.data[s][i * STRESS_CHANNELS + 1] = -(float)frame;
+                }
+            }
+            ring_buffer_commit_write(rb, granted);
+            next += granted;
+        } else {
+            for (int i = 0; i < count; i++) {
+                chunk[i * STRESS_CHANNELS] = (float)(next + i);
+                chunk[i * STRESS_CHANNELS + 1] = -(float)(next + i);
+            }
+            while (!ring_buffer_write(rb, chunk, count)) {sched_yield();}
+            next += count;
+        }
+        useRegion = !useRegion;
+    }
+    return NULL;
+}
+
+static void* stress_consumer(void *args) {
+    StressThread *thread = (StressThread*)args;
+    RingBuffer *rb = thread->rb;
+    float chunk[MAX_CHUNK * STRESS_CHANNELS];
+    int expected = 0;
+    bool useRegion = true;
+
+    while (expected < STRESS_FRAMES) {
+        int count = random_chunk(&thread->seed);
+        if (count > STRESS_FRAMES - expected) {count = STRESS_FRAMES - expected;}
+
+        if (useRegion) {
+            RingBufferRegion region;
+            const int granted = ring_buffer_acquire_read(rb, count, &region);
+            for (int s = 0; s < 2; s++) {
+                for (int i = 0; i < region.frames[s]; i++, expected++) {
+                    if (thread->ok && (region.data[s][i * STRESS_CHANNELS] != (float)expected ||
+                                       region.data[s][i * STRESS_CHANNELS + 1] != -(float)expected)) {
+                        thread->ok = fail("region read out of sequence");
+                    }
+                }
+            }
+            ring_buffer_commit_read(rb, granted);
+        } else {
+            while (!ring_buffer_read(rb, chunk, count)) {sched_yield();}
+            for (int i = 0; i < count; i++, expected++) {
+                if (thread->ok && (chunk[i * STRESS_CHANNELS] != (float)expected ||
+                                   chunk[i * STRESS_CHANNELS + 1] != -(float)expected)) {
+                    thread->ok = fail("copied read out of sequence");
+                }
+            }
+        }
+        useRegion = !useRegion;
+    }
+    return NULL;
+}
+
+static bool test_stress(void) {
+    RingBuffer *rb = create_ring_buffer(STRESS_CAPACITY, STRESS_CHANNELS);
+    StressThread producer = {rb, 1, true};
+    StressThread consumer = {rb, 2, true};
+
+    pthread_t producerThread, consumerThread;
+    pthread_create(&producerThread, NULL, stress_producer, &producer);
+    pthread_create(&consumerThread, NULL, stress_consumer, &consumer);
+    // the consumer drains everything even after a mismatch so the producer can finish
+    pthread_join(consumerThread, NULL);
+    pthread_join(producerThread, NULL);
+
+    const bool ok = consumer.ok && ring_buffer_read_available(rb) == 0;
+    destroy_ring_buffer(rb);
+    return ok;
+}
+
+int main(void) {
+    bool ok = true;
+    ok = test_capacity() && ok;
+    ok = test_wrapping_region() && ok;
+    ok = test_stress() && ok;
+
+    if (!ok) {return 1;}
+    printf("PASS ring buffer (%d frames of %d channels streamed)\n", STRESS_FRAMES, STRESS_CHANNELS);
+    return 0;
+}
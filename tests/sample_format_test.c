@@ -0,0 +1,230 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "audio_graph.h"
+#include "sample_format.h"
+#include "sine_osc_module.h"
+#include "lowpass_filter_module.h"
+#include "output_module.h"
+
+/*
+ * Checks the compact sample formats against their error budgets, first
+ * sample by sample and then through a graph whose connections are
+ * stored compactly, compared with the same graph kept in float.
+ */
+
+#define TEST_SAMPLE_RATE 44100
+#define TEST_BLOCK_SIZE 256
+// odd, so the vector loops leave a scalar tail
+#define NUM_VALUES 1003
+
+// half a step of int16 storage, and the relative rounding of binary16
+#define INT16_BUDGET (0.5f * SAMPLE_INT16_RANGE / 32768.0f)
+#define HALF_BUDGET (1.0f / 2048.0f)
+
+static uint32_t rng_state = 1;
+
+static float random_uniform(void) {
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return (rng_state >> 8) * (1.0f / 16777216.0f);
+}
+
+static bool test_int16(void) {
+    float input[NUM_VALUES];
+    int16_t stored[NUM_VALUES];
+    float output[NUM_VALUES] = {0};
+
+    for (int i = 0; i < NUM_VALUES; i++) {
+        input[i] = (2.0f * random_uniform() - 1.0f) * (SAMPLE_INT16_RANGE - INT16_BUDGET);
+    }
+    input[0] = 0.0f;
+    input[1] = -SAMPLE_INT16_RANGE;
+    float_to_int16(input, stored, NUM_VALUES);
+    int16_accumulate(stored, output, 1.0f, NUM_VALUES);
+
+    for (int i = 0; i < NUM_VALUES; i++) {
+        if (!(fabsf(output[i] - input[i]) <= INT16_BUDGET) || output[i] != int16_sample(stored[i])) {
+            fprintf(stderr, "FAIL int16 stores %g as %g\n", input[i], output[i]);
+            return false;
+        }
+    }
+
+    // out of range values saturate, at either end of a vector
+    const float loud[9] = {5.0f, -5.0f, 1e30f, -1e30f, INFINITY, -INFINITY, 3.0f, -3.0f, 100.0f};
+    const float expected[9] = {
+        SAMPLE_INT16_RANGE - 2.0f * INT16_BUDGET, -SAMPLE_INT16_RANGE,
+        SAMPLE_INT16_RANGE - 2.0f * INT16_BUDGET, -SAMPLE_INT16_RANGE,
+        SAMPLE_INT16_RANGE - 2.0f * INT16_BUDGET, -SAMPLE_INT16_RANGE,
+        SAMPLE_INT16_RANGE - 2.0f * INT16_BUDGET, -SAMPLE_INT16_RANGE,
+        SAMPLE_INT16_RANGE - 2.0f * INT16_BUDGET,
+    };
+    int16_t clipped[9];
+    float_to_int16(loud, clipped, 9);
+    for (int i = 0; i < 9; i++) {
+        if (int16_sample(clipped[i]) != expected[i]) {
+            fprintf(stderr, "FAIL int16 saturates %g to %g\n", loud[i], int16_sample(clipped[i]));
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool test_half(void) {
+    float input[NUM_VALUES];
+    uint16_t stored[NUM_VALUES];
+    float output[NUM_VALUES] = {0};
+
+    // magnitudes spread evenly in log from 2^-30 to 2^16, subnormals included
+    for (int i = 0; i < NUM_VALUES; i++) {
+        const float magnitude = exp2f(-30.0f + 46.0f * random_uniform());
+        input[i] = (i & 1) ? -magnitude : magnitude;
+    }
+    input[0] = 0.0f;
+    input[1] = 65504.0f;
+    input[2] = 1.0f / 16384.0f;
+    float_to_half(input, stored, NUM_VALUES);
+    half_accumulate(stored, output, 1.0f, NUM_VALUES);
+
+    for (int i = 0; i < NUM_VALUES; i++) {
+        const float magnitude = fabsf(input[i]);
+        const float error = fabsf(output[i] - input[i]);
+        // below 2^-14 the spacing is fixed at 2^-24
+        const float budget = magnitude < 1.0f / 16384.0f ? 1.0f / 33554432.0f : magnitude * HALF_BUDGET;
+
+        if (magnitude >= 65520.0f) {
+            if (!isinf(output[i])) {
+                fprintf(stderr, "FAIL half stores %g as %g instead of infinity\n", input[i], output[i]);
+                return false;
+            }
+        } else if (!(error <= budget) || output[i] != half_sample(stored[i])) {
+            fprintf(stderr, "FAIL half stores %g as %g\n", input[i], output[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Converts the same values in one call, which goes through the vector
+ * loops where the CPU has them, and one sample per call, which always
+ * takes the scalar tail; the two have to agree bit for bit.
+ */
+static bool test_vector_paths(void) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    // a default build has to pick up F16C at run time
+    if (__builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c") &&
+        !sample_format_vectorized(SAMPLE_FORMAT_HALF)) {
+        fprintf(stderr, "FAIL half conversion is not vectorised on a CPU with F16C\n");
+        return false;
+    }
+#endif
+
+    float input[NUM_VALUES];
+    int16_t narrow[NUM_VALUES];
+    uint16_t half[NUM_VALUES];
+    float wide[NUM_VALUES] = {0};
+    float halfWide[NUM_VALUES] = {0};
+
+    for (int i = 0; i < NUM_VALUES; i++) {
+        const float magnitude = exp2f(-30.0f + 48.0f * random_uniform());
+        input[i] = (i & 1) ? -magnitude : magnitude;
+    }
+    input[3] = INFINITY;
+    float_to_int16(input, narrow, NUM_VALUES);
+    float_to_half(input, half, NUM_VALUES);
+    int16_accumulate(narrow, wide, 0.5f, NUM_VALUES);
+    half_accumulate(half, halfWide, 0.5f, NUM_VALUES);
+
+    for (int i = 0; i < NUM_VALUES; i++) {
+        int16_t narrowOne;
+        uint16_t halfOne;
+        float wideOne = 0.0f, halfWideOne = 0.0f;
+        float_to_int16(&input[i], &narrowOne, 1);
+        float_to_half(&input[i], &halfOne, 1);
+        int16_accumulate(&narrow[i], &wideOne, 0.5f, 1);
+        half_accumulate(&half[i], &halfWideOne, 0.5f, 1);
+
+        if (narrowOne != narrow[i] || halfOne != half[i] || wideOne != wide[i] || halfWideOne != halfWide[i]) {
+            fprintf(stderr, "FAIL vector and scalar conversions of %g differ\n", input[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Three oscillators mix into a two filter chain feeding the output.
+ * Compact storage applies to every connection, so the oscillators and the
+ * fused chain's tail are stored narrow.
+ */
+static bool test_graph(SampleFormat format, float budget) {
+    AudioGraph *graphs[2];
+    OutputNode *outputs[2];
+
+    for (int g = 0; g < 2; g++) {
+        AudioGraph *graph = create_audio_graph();
+        AudioNode *first = create_audio_node(&LowPassFilterModule);
+        AudioNode *second = create_audio_node(&LowPassFilterModule);
+        AudioNode *out = create_audio_node(&OutputNodeModule);
+        add_node(graph, first);
+        add_node(graph, second);
+        add_node(graph, out);
+
+        for (int i = 0; i < 3; i++) {
+            AudioNode *osc = create_audio_node(&SineOscillatorModule);
+            add_node(graph, osc);
+            osc->interface->setParameter(osc->instance, OSC_FREQUENCY_PARAM, 110.0f * (i + 1) + 7.0f);
+            osc->interface->setParameter(osc->instance, OSC_GAIN_PARAM, 0.9f);
+            Connection *conn = connect_nodes(graph, osc, first);
+            if (g == 1) {conn->format = format;}
+        }
+        first->interface->setParameter(first->instance, LPF_CUTOF_PARAM, 2000.0f);
+        second->interface->setParameter(second->instance, LPF_CUTOF_PARAM, 5000.0f);
+        Connection *chain = connect_nodes(graph, first, second);
+        Connection *tail = connect_nodes(graph, second, out);
+        if (g == 1) {
+            chain->format = format;
+            tail->format = format;
+        }
+
+        init_graph(graph, TEST_SAMPLE_RATE, TEST_BLOCK_SIZE);
+        graphs[g] = graph;
+        outputs[g] = (OutputNode*)out->instance;
+    }
+
+    float worst = 0.0f;
+    for (int b = 0; b < 64; b++) {
+        process_graph(graphs[0], TEST_BLOCK_SIZE);
+        process_graph(graphs[1], TEST_BLOCK_SIZE);
+        for (int i = 0; i < TEST_BLOCK_SIZE; i++) {
+            const float error = fabsf(outputs[1]->outputs[0][i] - outputs[0]->outputs[0][i]);
+            if (error > worst) {worst = error;}
+        }
+    }
+    const int numSteps = graphs[1]->numSteps;
+    destroy_audio_graph(graphs[0]);
+    destroy_audio_graph(graphs[1]);
+
+    if (numSteps != 5 || !(worst <= budget)) {
+        fprintf(stderr, "FAIL %s graph off by %g in %d steps\n",
+                format == SAMPLE_FORMAT_INT16 ? "int16" : "half", worst, numSteps);
+        return false;
+    }
+    return true;
+}
+
+int main(void) {
+    bool ok = true;
+    ok = test_int16() && ok;
+    ok = test_half() && ok;
+    ok = test_vector_paths() && ok;
+    // two rounding points on the way to the output, each within its budget
+    ok = test_graph(SAMPLE_FORMAT_INT16, 2.0f * INT16_BUDGET) && ok;
+    ok = test_graph(SAMPLE_FORMAT_HALF, 2.0f * HALF_BUDGET) && ok;
+
+    if (!ok) {return 1;}
+    printf("PASS sample_format\n");
+    return 0;
+}
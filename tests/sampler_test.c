@@ -0,0 +1,360 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "wav_file.h"
+#include "resampler.h"
+#include "sampler_module.h"
+
+/*
+ * Checks the vector wav conversions against a plain scalar decode for
+ * every format and channel layout, then streams a file longer than the
+ * preload plus the stream-ahead window at a paced rate, looping once, and
+ * compares what the samplers play with the decoded file. The shared
+ * streaming thread has to leave idle voices alone. A file at
+ * another rate has to play as the whole decoded file resampled offline,
+ * delayed by the resampler latency.
+ */
+
+#define TEST_SAMPLE_RATE 44100
+#define TEST_BLOCK_SIZE 256
+// faster than real time but well within what the streaming thread keeps up with
+#define PACE_SPEEDUP 8
+
+static uint32_t rng_state = 1;
+
+static uint32_t random_u32(void) {
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state;
+}
+
+static float reference_sample(WavSampleFormat format, const unsigned char *p) {
+    switch (format) {
+        case WAV_FORMAT_PCM16:
+            return (float)(int16_t)(p[0] | p[1] << 8);
+        case WAV_FORMAT_PCM24: {
+            int32_t v = p[0] | p[1] << 8 | p[2] << 16;
+            if (v & 0x800000) {v -= 0x1000000;}
+            return (float)v;
+        }
+        case WAV_FORMAT_PCM32:
+            return (float)(int32_t)((uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+        default: {
+            float value;
+            memcpy(&value, p, sizeof(value));
+            return value;
+        }
+    }
+}
+
+static float format_scale(WavSampleFormat format) {
+    switch (format) {
+        case WAV_FORMAT_PCM16: return 1.0f / 32768.0f;
+        case WAV_FORMAT_PCM24: return 1.0f / 8388608.0f;
+        case WAV_FORMAT_PCM32: return 1.0f / 2147483648.0f;
+        default: return 1.0f;
+    }
+}
+
+static bool test_conversions(void) {
+    const WavSampleFormat formats[] = {WAV_FORMAT_PCM16, WAV_FORMAT_PCM24, WAV_FORMAT_PCM32, WAV_FORMAT_FLOAT32};
+    const int bytesPerSample[] = {2, 3, 4, 4};
+    const int numFrames = 203;
+    bool ok = true;
+
+    for (int f = 0; f < 4; f++) {
+        for (int channels = 1; channels <= 3; channels++) {
+            WavInfo info = {formats[f], TEST_SAMPLE_RATE, channels, numFrames, bytesPerSample[f] * channels, 0};
+            const size_t size = (size_t)numFrames * info.bytesPerFrame;
+            unsigned char *data = (unsigned char*)malloc(size);
+            for (size_t i = 0; i < size; i++) {
+                data[i] = (unsigned char)(random_u32() >> 24);
+            }
+            if (formats[f] == WAV_FORMAT_FLOAT32) {
+                for (size_t i = 0; i < size; i += 4) {
+                    const float value = (float)(int32_t)random_u32() / 2147483648.0f;
+                    memcpy(data + i, &value, sizeof(value));
+                }
+            }
+
+            float output[203], expected[203];
+            const float scale = format_scale(formats[f]);
+
+            // every start offset so the vector loops meet every tail length
+            for (int start = 0; start < 8; start++) {
+                const unsigned char *frames = data + (size_t)start * info.bytesPerFrame;
+                const int count = numFrames - start;
+
+                for (int c = 0; c < channels; c++) {
+                    convert_wav_channel(&info, frames, c, output, count);
+                    for (int i = 0; i < count; i++) {
+                        expected[i] = reference_sample(formats[f], frames + i * info.bytesPerFrame + c * bytesPerSample[f]) * scale;
+                    }
+                    if (memcmp(output, expected, count * sizeof(float)) != 0) {
+                        fprintf(stderr, "FAIL format %d, %d channels: channel %d differs from offset %d\n",
+                                f, channels, c, start);
+                        ok = false;
+                    }
+                }
+
+                convert_wav_mono(&info, frames, output, count);
+                for (int i = 0; i < count; i++) {
+                    float sum = 0.0f;
+                    for (int c = 0; c < channels; c++) {
+                        sum += reference_sample(formats[f], frames + i * info.bytesPerFrame + c * bytesPerSample[f]);
+                    }
+                    expected[i] = sum * (scale * (1.0f / channels));
+                }
+                if (memcmp(output, expected, count * sizeof(float)) != 0) {
+                    fprintf(stderr, "FAIL format %d, %d channels: mixdown differs from offset %d\n",
+                            f, channels, start);
+                    ok = false;
+                }
+            }
+            free(data);
+        }
+    }
+    return ok;
+}
+
+static bool write_stereo_pcm24(const char *path, int numFrames, int rate) {
+    FILE *file = fopen(path, "wb");
+    if (!file) {return false;}
+
+    const uint32_t dataSize = numFrames * 6;
+    const uint32_t riffSize = 36 + dataSize;
+    const uint32_t fmtSize = 16;
+    const uint16_t formatTag = 1, channels = 2, blockAlign = 6, bits = 24;
+    const uint32_t sampleRate = rate, byteRate = rate * 6;
+
+    fwrite("RIFF", 1, 4, file);
+    fwrite(&riffSize, 4, 1, file);
+    fwrite("WAVEfmt ", 1, 8, file);
+    fwrite(&fmtSize, 4, 1, file);
+    fwrite(&formatTag, 2, 1, file);
+    fwrite(&channels, 2, 1, file);
+    fwrite(&sampleRate, 4, 1, file);
+    fwrite(&byteRate, 4, 1, file);
+    fwrite(&blockAlign, 2, 1, file);
+    fwrite(&bits, 2, 1, file);
+    fwrite("data", 1, 4, file);
+    fwrite(&dataSize, 4, 1, file);
+
+    // a sweep on the left and noise on the right, so a wrong frame is obvious
+    unsigned char frame[6];
+    for (int i = 0; i < numFrames; i++) {
+        const int32_t left = (int32_t)(sin(i * (0.001 + i * 1e-8)) * 8000000.0);
+        const int32_t right = (int32_t)(random_u32() >> 8) - 0x800000;
+        for (int b = 0; b < 3; b++) {
+            frame[b] = (unsigned char)(left >> (8 * b));
+            frame[3 + b] = (unsigned char)(right >> (8 * b));
+        }
+        fwrite(frame, 1, sizeof(frame), file);
+    }
+    return fclose(file) == 0;
+}
+
+static void sleep_until(struct timespec *deadline, long periodNs) {
+    deadline->tv_nsec += periodNs;
+    if (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_nsec -= 1000000000L;
+        deadline->tv_sec++;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, deadline, NULL);
+}
+
+/*
+ * Two voices of the same long file share the streaming thread, the second
+ * triggered a third of the way into the first, and both loop once.
+ */
+static bool test_streaming(void) {
+    const int numFrames = SAMPLER_PRELOAD_FRAMES + SAMPLER_STREAM_AHEAD_FRAMES + 40000;
+    const int numRendered = 2 * numFrames + 10000;
+    const int secondStart = numFrames / 3 / TEST_BLOCK_SIZE * TEST_BLOCK_SIZE;
+    const float gain = 0.5f;
+
+    char path[] = "/tmp/keiko_sampler_XXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0) {return false;}
+    close(fd);
+
+    bool ok = write_stereo_pcm24(path, numFrames, TEST_SAMPLE_RATE);
+    int decodedFrames = 0, decodedRate = 0;
+    float *decoded = ok ? load_wav_mono(path, &decodedFrames, &decodedRate) : NULL;
+    Sampler *samplers[2] = {(Sampler*)SamplerModule.create(), (Sampler*)SamplerModule.create()};
+    bool loaded = samplers[0] && samplers[1];
+    for (int v = 0; v < 2 && loaded; v++) {
+        loaded = sampler_load(samplers[v], path);
+    }
+    if (!decoded || decodedFrames != numFrames || !loaded) {
+        fprintf(stderr, "FAIL could not write and load %s\n", path);
+        free(decoded);
+        for (int v = 0; v < 2; v++) {
+            if (samplers[v]) {SamplerModule.destroy(samplers[v]);}
+        }
+        unlink(path);
+        return false;
+    }
+
+    for (int v = 0; v < 2; v++) {
+        SamplerModule.init(samplers[v], TEST_SAMPLE_RATE, TEST_BLOCK_SIZE);
+        SamplerModule.setParameter(samplers[v], SAMPLER_GAIN_PARAM, gain);
+        SamplerModule.setParameter(samplers[v], SAMPLER_LOOP_PARAM, 1.0f);
+    }
+    SamplerModule.setParameter(samplers[0], SAMPLER_TRIGGER_PARAM, 1.0f);
+
+    const long periodNs = 1000000000L / PACE_SPEEDUP / TEST_SAMPLE_RATE * TEST_BLOCK_SIZE;
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+    float block[TEST_BLOCK_SIZE];
+    int mismatch[2] = {-1, -1};
+    for (int rendered = 0; rendered < numRendered + secondStart; rendered += TEST_BLOCK_SIZE) {
+        if (rendered == secondStart) {
+            SamplerModule.setParameter(samplers[1], SAMPLER_TRIGGER_PARAM, 1.0f);
+        }
+        for (int v = 0; v < 2; v++) {
+            const int position = rendered - (v == 1 ? secondStart : 0);
+            if (position < 0 || position >= numRendered) {continue;}
+
+            SamplerModule.process(samplers[v], NULL, block, TEST_BLOCK_SIZE);
+            for (int i = 0; i < TEST_BLOCK_SIZE && mismatch[v] < 0; i++) {
+                if (block[i] != decoded[(position + i) % numFrames] * gain) {
+                    mismatch[v] = position + i;
+                }
+            }
+        }
+        sleep_until(&deadline, periodNs);
+    }
+
+    for (int v = 0; v < 2; v++) {
+        const int underruns = atomic_load(&samplers[v]->underruns);
+        if (mismatch[v] >= 0) {
+            fprintf(stderr, "FAIL voice %d differs from the file at frame %d\n", v, mismatch[v]);
+            ok = false;
+        }
+        if (underruns != 0) {
+            fprintf(stderr, "FAIL voice %d had %d underruns while streaming\n", v, underruns);
+            ok = false;
+        }
+        SamplerModule.destroy(samplers[v]);
+    }
+
+    free(decoded);
+    unlink(path);
+    return ok;
+}
+
+// a loaded voice that is not playing must not be serviced; a trigger wakes the streamer
+static bool test_idle_streamer(void) {
+    const int numFrames = SAMPLER_PRELOAD_FRAMES + SAMPLER_STREAM_AHEAD_FRAMES;
+
+    char path[] = "/tmp/keiko_sampler_XXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0) {return false;}
+    close(fd);
+
+    Sampler *sampler = (Sampler*)SamplerModule.create();
+    if (!sampler || !write_stereo_pcm24(path, numFrames, TEST_SAMPLE_RATE) || !sampler_load(sampler, path)) {
+        fprintf(stderr, "FAIL could not write and load %s\n", path);
+        if (sampler) {SamplerModule.destroy(sampler);}
+        unlink(path);
+        return false;
+    }
+    SamplerModule.init(sampler, TEST_SAMPLE_RATE, TEST_BLOCK_SIZE);
+
+    bool ok = true;
+    usleep(50000);
+    if (atomic_load(&sampler->ready) != 0) {
+        fprintf(stderr, "FAIL streamer serviced a sampler that is not playing\n");
+        ok = false;
+    }
+
+    float block[TEST_BLOCK_SIZE];
+    SamplerModule.setParameter(sampler, SAMPLER_TRIGGER_PARAM, 1.0f);
+    SamplerModule.process(sampler, NULL, block, TEST_BLOCK_SIZE);
+    int waited = 0;
+    for (; waited < 1000 && atomic_load(&sampler->ready) == 0; waited++) {
+        usleep(1000);
+    }
+    if (waited == 1000) {
+        fprintf(stderr, "FAIL trigger did not wake the streamer\n");
+        ok = false;
+    }
+
+    SamplerModule.destroy(sampler);
+    unlink(path);
+    return ok;
+}
+
+static bool test_resampled(int fileRate) {
+    const int numFrames = 20000;
+
+    char path[] = "/tmp/keiko_sampler_XXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0) {return false;}
+    close(fd);
+
+    bool ok = write_stereo_pcm24(path, numFrames, fileRate);
+    int decodedFrames = 0, decodedRate = 0, numExpected = 0;
+    float *decoded = ok ? load_wav_mono(path, &decodedFrames, &decodedRate) : NULL;
+    float *expected = decoded ? resample_buffer(decoded, decodedFrames, fileRate, TEST_SAMPLE_RATE, &numExpected) : NULL;
+    Sampler *sampler = (Sampler*)SamplerModule.create();
+    if (!expected || !sampler || !sampler_load(sampler, path)) {
+        fprintf(stderr, "FAIL could not write and load %s\n", path);
+        free(decoded);
+        free(expected);
+        if (sampler) {SamplerModule.destroy(sampler);}
+        unlink(path);
+        return false;
+    }
+
+    SamplerModule.init(sampler, TEST_SAMPLE_RATE, TEST_BLOCK_SIZE);
+    SamplerModule.setParameter(sampler, SAMPLER_TRIGGER_PARAM, 1.0f);
+
+    const int latency = resampler_latency(sampler->resampler);
+    const int numRendered = (latency + numExpected) / TEST_BLOCK_SIZE * TEST_BLOCK_SIZE + 4 * TEST_BLOCK_SIZE;
+    float *rendered = (float*)malloc(numRendered * sizeof(float));
+    // shorter blocks than announced to init, as when a graph splits a block
+    for (int i = 0; i < numRendered; i += TEST_BLOCK_SIZE / 2) {
+        SamplerModule.process(sampler, NULL, rendered + i, TEST_BLOCK_SIZE / 2);
+    }
+
+    float worst = 0.0f;
+    for (int j = 0; j < numExpected; j++) {
+        const float error = fabsf(rendered[latency + j] - expected[j]);
+        if (error > worst) {worst = error;}
+    }
+    if (!(worst < 1e-6f)) {
+        fprintf(stderr, "FAIL %d Hz sample off by %g at %d Hz\n", fileRate, worst, TEST_SAMPLE_RATE);
+        ok = false;
+    }
+    if (SamplerModule.getParameter(sampler, SAMPLER_TRIGGER_PARAM) != 0.0f) {
+        fprintf(stderr, "FAIL %d Hz sample still playing after its resampled length\n", fileRate);
+        ok = false;
+    }
+
+    SamplerModule.destroy(sampler);
+    free(rendered);
+    free(expected);
+    free(decoded);
+    unlink(path);
+    return ok;
+}
+
+int main(void) {
+    bool ok = true;
+    ok = test_conversions() && ok;
+    ok = test_streaming() && ok;
+    ok = test_idle_streamer() && ok;
+    ok = test_resampled(48000) && ok;
+    ok = test_resampled(22050) && ok;
+
+    if (!ok) {return 1;}
+    printf("PASS sampler\n");
+    return 0;
+}